@@ -0,0 +1,20 @@
+#version 330 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 2) in vec2 vertexUV;
+
+// Per instance data: position (xy) and scale (z)
+layout(location = 4) in vec4 instance;
+
+uniform mat4 MVP;
+
+out vec2 UV;
+
+void main() {
+    vec4 v = vec4(vertexPosition_modelspace * instance.z + vec3(instance.xy, 0), 1);
+    gl_Position = MVP * v;
+
+    UV = vertexUV;
+}
+
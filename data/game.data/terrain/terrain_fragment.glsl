@@ -1,9 +1,11 @@
 #version 330 core
 
-out vec3 clr;
+uniform vec4 color;
+
+out vec4 clr;
 
 void main()
 {
-	clr = vec3(1, 1, 1);
+	clr = color;
 }
 
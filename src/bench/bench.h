@@ -0,0 +1,84 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_BENCH_H
+#define LUOLA_BENCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace bench {
+
+/**
+ * Benchmark entry point.
+ *
+ * @param args command line arguments following the benchmark name
+ * @return process exit code
+ */
+typedef int (*BenchFunction)(const std::vector<string> &args);
+
+/**
+ * Benchmark registration.
+ *
+ * Create a static instance of this class in the benchmark's
+ * source file to make it available in luola2-bench.
+ */
+class Benchmark {
+public:
+    Benchmark(const string &name, const string &description, BenchFunction fn);
+
+    const string &name() const { return m_name; }
+    const string &description() const { return m_description; }
+    int run(const std::vector<string> &args) const { return m_fn(args); }
+
+    /**
+     * Get the list of all registered benchmarks.
+     *
+     * @return benchmark list
+     */
+    static const std::vector<const Benchmark*> &all();
+
+private:
+    string m_name;
+    string m_description;
+    BenchFunction m_fn;
+};
+
+/**
+ * Get a monotonic timestamp.
+ *
+ * @return time in nanoseconds
+ */
+uint64_t now();
+
+/**
+ * Get the numeric argument at the given index.
+ *
+ * @param args argument list
+ * @param i argument index
+ * @param def value to return if the argument was not given
+ * @return argument value
+ */
+int intArg(const std::vector<string> &args, unsigned int i, int def);
+
+}
+
+#endif
+
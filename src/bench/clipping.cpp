@@ -0,0 +1,218 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+
+#include "../terrain/clip.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::ConvexPolygon;
+using terrain::Point;
+using terrain::Points;
+
+/*
+ * Terrain hole clipping backends.
+ *
+ * A block of terrain made of triangles is riddled with random
+ * polygonal holes, one at a time, using each clipping backend in turn.
+ * Every polygon overlapping a hole is replaced by its difference with
+ * the hole, the same way Terrain::nibble does it.
+ *
+ * Failures are operations the backend rolled back. The area error is
+ * the total difference between the area each operation should have
+ * removed and the area it actually removed, relative to the expected
+ * total.
+ */
+namespace {
+
+const int BLOCK_SIZE = 40;
+
+float area(const Points &points)
+{
+    float a = 0;
+    for(unsigned int i=0;i<points.size();++i) {
+        const Point &p = points[i];
+        const Point &q = points[(i+1) % points.size()];
+        a += p.x * q.y - p.y * q.x;
+    }
+    return a * 0.5f;
+}
+
+// Area of the intersection of two convex polygons
+float intersectionArea(const ConvexPolygon &poly, const ConvexPolygon &hole)
+{
+    Points out = poly.vertices(), in;
+    for(int i=0;i<hole.vertexCount() && !out.empty();++i) {
+        const Point a = hole.vertex(i);
+        const glm::vec2 e = hole.vertex(i+1) - a;
+        in.swap(out);
+        out.clear();
+        for(unsigned int j=0;j<in.size();++j) {
+            const Point &p = in[j];
+            const Point &q = in[(j+1) % in.size()];
+            const float sp = e.x * (p.y - a.y) - e.y * (p.x - a.x);
+            const float sq = e.x * (q.y - a.y) - e.y * (q.x - a.x);
+            if(sp >= 0)
+                out.push_back(p);
+            if((sp > 0 && sq < 0) || (sp < 0 && sq > 0))
+                out.push_back(p + (q - p) * (sp / (sp - sq)));
+        }
+    }
+    return out.size() < 3 ? 0 : area(out);
+}
+
+// A square block of triangles on a jittered lattice
+std::vector<ConvexPolygon> makeBlock()
+{
+    std::mt19937 rng(BLOCK_SIZE);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    const int stride = BLOCK_SIZE + 1;
+    Points lattice;
+    for(int y=0;y<=BLOCK_SIZE;++y)
+        for(int x=0;x<=BLOCK_SIZE;++x)
+            lattice.push_back(Point(x + jitter(rng), y + jitter(rng)));
+
+    std::vector<ConvexPolygon> polys;
+    for(int y=0;y<BLOCK_SIZE;++y) {
+        for(int x=0;x<BLOCK_SIZE;++x) {
+            const Point &a = lattice[y * stride + x];
+            const Point &b = lattice[y * stride + x + 1];
+            const Point &c = lattice[(y+1) * stride + x + 1];
+            const Point &d = lattice[(y+1) * stride + x];
+            polys.push_back(ConvexPolygon(Points { a, b, c }));
+            polys.push_back(ConvexPolygon(Points { a, c, d }));
+        }
+    }
+    return polys;
+}
+
+std::vector<ConvexPolygon> makeHoles(int count)
+{
+    std::mt19937 rng(count);
+    std::uniform_real_distribution<float> pos(0, BLOCK_SIZE);
+    std::uniform_real_distribution<float> radius(0.2f, 2.0f);
+    std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+    std::uniform_int_distribution<int> sides(3, 12);
+
+    std::vector<ConvexPolygon> holes;
+    for(int i=0;i<count;++i) {
+        const Point c(pos(rng), pos(rng));
+        const float r = radius(rng);
+        const float a0 = angle(rng);
+        const int n = sides(rng);
+
+        Points points;
+        for(int s=0;s<n;++s) {
+            const float a = a0 + s * 2 * M_PI / n;
+            points.push_back(c + Point(std::cos(a), std::sin(a)) * r);
+        }
+        holes.push_back(ConvexPolygon(points));
+    }
+    return holes;
+}
+
+struct Result {
+    uint64_t ns;
+    int operations;
+    int failures;
+    double expected, error;
+    unsigned int polygons;
+};
+
+Result riddle(terrain::Clipper clipper, const std::vector<ConvexPolygon> &holes)
+{
+    std::vector<ConvexPolygon> polys = makeBlock(), next, pieces;
+    Result r = Result();
+
+    for(const ConvexPolygon &hole : holes) {
+        next.clear();
+
+        uint64_t t0 = bench::now();
+        for(const ConvexPolygon &poly : polys) {
+            if(!poly.bounds().overlaps(hole.bounds()) || !poly.overlaps(hole)) {
+                next.push_back(poly);
+                continue;
+            }
+
+            pieces.clear();
+            ++r.operations;
+            if(!terrain::difference(clipper, poly, hole, pieces))
+                ++r.failures;
+
+            // Not timed
+            const uint64_t t1 = bench::now();
+            const float expected = intersectionArea(poly, hole);
+            float remaining = 0;
+            for(const ConvexPolygon &p : pieces)
+                remaining += area(p.vertices());
+            r.expected += expected;
+            r.error += std::fabs(area(poly.vertices()) - remaining - expected);
+            t0 += bench::now() - t1;
+
+            next.insert(next.end(), pieces.begin(), pieces.end());
+        }
+        r.ns += bench::now() - t0;
+
+        polys.swap(next);
+    }
+
+    r.polygons = polys.size();
+    return r;
+}
+
+void print(const char *name, const Result &r, int holes)
+{
+    cout << std::setw(8) << name
+         << std::fixed << std::setprecision(0)
+         << std::setw(12) << holes / (r.ns / 1e9)
+         << std::setw(12) << r.operations
+         << std::setprecision(3)
+         << std::setw(12) << 100.0 * r.failures / r.operations << "%"
+         << std::setprecision(4)
+         << std::setw(12) << 100.0 * r.error / r.expected << "%"
+         << std::setw(10) << r.polygons
+         << "\n";
+}
+
+int run(const std::vector<string> &args)
+{
+    const int count = bench::intArg(args, 0, 2000);
+    const std::vector<ConvexPolygon> holes = makeHoles(count);
+
+    cout << "Making " << count << " holes in a " << BLOCK_SIZE << "x" << BLOCK_SIZE << " block\n";
+    cout << std::setw(8) << "clipper"
+         << std::setw(12) << "holes/s"
+         << std::setw(12) << "operations"
+         << std::setw(13) << "failures"
+         << std::setw(13) << "area error"
+         << std::setw(10) << "polygons"
+         << "\n";
+
+    print("trace", riddle(terrain::TRACE_CLIPPER, holes), count);
+    print("fixed", riddle(terrain::FIXED_CLIPPER, holes), count);
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("clipping", "terrain hole throughput and failure rate per clipping backend [holes]", run);
+
+}
@@ -0,0 +1,159 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+
+#include "../physics.h"
+#include "../broadphase.h"
+#include "bench.h"
+
+using std::cout;
+
+/*
+ * Ship-ship collision detection scaling.
+ *
+ * This times only collision detection (broadphase and the exact circle
+ * test), not a whole simulation tick: ships are moved in a straight line
+ * outside the timed section and no other part of World::step is run.
+ * See the "tick" benchmark for full tick times.
+ *
+ * Ships are scattered over an area that grows with the ship count,
+ * so the density (and the number of actual collisions per ship) stays
+ * roughly constant. Both the old all-pairs loop and the grid broadphase
+ * are run on the same positions every tick.
+ */
+namespace {
+
+const int TICKS = 200;
+
+// Area per ship (in square units)
+const float AREA_PER_SHIP = 64.0f;
+
+struct Body {
+    Physical phys;
+    glm::vec2 vel;
+};
+
+void moveBodies(std::vector<Body> &bodies, float size)
+{
+    for(Body &b : bodies) {
+        glm::vec2 p = b.phys.position() + b.vel * Physical::TIMESTEP;
+        if(p.x < 0 || p.x > size)
+            b.vel.x = -b.vel.x;
+        if(p.y < 0 || p.y > size)
+            b.vel.y = -b.vel.y;
+        b.phys.setPosition(p);
+    }
+}
+
+int bruteForce(std::vector<Body> &bodies)
+{
+    int hits = 0;
+    for(unsigned int i=0;i<bodies.size();++i) {
+        for(unsigned int j=i+1;j<bodies.size();++j) {
+            if(bodies[i].phys.checkCollision(bodies[j].phys))
+                ++hits;
+        }
+    }
+    return hits;
+}
+
+int broadphase(std::vector<Body> &bodies, Broadphase &grid, std::vector<Broadphase::Pair> &pairs)
+{
+    grid.clear();
+    for(const Body &b : bodies)
+        grid.add(b.phys.position(), b.phys.radius());
+
+    grid.findPairs(pairs);
+
+    int hits = 0;
+    for(const Broadphase::Pair &p : pairs) {
+        if(bodies[p.first].phys.checkCollision(bodies[p.second].phys))
+            ++hits;
+    }
+    return hits;
+}
+
+int run(const std::vector<string> &args)
+{
+    const int maxships = bench::intArg(args, 0, 2000);
+
+    cout << std::setw(8) << "ships"
+         << std::setw(16) << "all-pairs us"
+         << std::setw(16) << "grid us"
+         << std::setw(10) << "speedup"
+         << std::setw(12) << "collisions"
+         << "\n";
+
+    bool mismatch = false;
+    for(int ships=10;ships<=maxships;ships*=2) {
+        std::mt19937 rng(ships);
+        const float size = std::sqrt(ships * AREA_PER_SHIP);
+        std::uniform_real_distribution<float> pos(0, size);
+        std::uniform_real_distribution<float> vel(-10, 10);
+        std::uniform_real_distribution<float> radius(0.5f, 1.5f);
+
+        std::vector<Body> bodies(ships);
+        for(Body &b : bodies) {
+            b.phys = Physical(1.0f, radius(rng), glm::vec2(pos(rng), pos(rng)), glm::vec2());
+            b.vel = glm::vec2(vel(rng), vel(rng));
+        }
+
+        Broadphase grid;
+        std::vector<Broadphase::Pair> pairs;
+
+        uint64_t brute_ns = 0, grid_ns = 0;
+        int brute_hits = 0, grid_hits = 0;
+        for(int tick=0;tick<TICKS;++tick) {
+            moveBodies(bodies, size);
+
+            uint64_t t0 = bench::now();
+            brute_hits += bruteForce(bodies);
+            uint64_t t1 = bench::now();
+            grid_hits += broadphase(bodies, grid, pairs);
+            uint64_t t2 = bench::now();
+
+            brute_ns += t1 - t0;
+            grid_ns += t2 - t1;
+        }
+
+        const double brute_us = brute_ns / 1000.0 / TICKS;
+        const double grid_us = grid_ns / 1000.0 / TICKS;
+
+        cout << std::setw(8) << ships
+             << std::fixed << std::setprecision(2)
+             << std::setw(16) << brute_us
+             << std::setw(16) << grid_us
+             << std::setw(9) << brute_us / grid_us << "x"
+             << std::setw(12) << grid_hits;
+        if(brute_hits != grid_hits) {
+            cout << " MISMATCH (all-pairs found " << brute_hits << ")";
+            mismatch = true;
+        }
+        cout << "\n";
+    }
+
+    return mismatch ? 1 : 0;
+}
+
+bench::Benchmark BENCHMARK("collisions", "ship-ship collision detection only (no full tick) vs. ship count [max ships]", run);
+
+}
+
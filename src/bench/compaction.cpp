@@ -0,0 +1,201 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+
+#include "../terrain/terrain.h"
+#include "../terrain/compact.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::ConvexPolygon;
+using terrain::Point;
+using terrain::Points;
+
+/*
+ * Terrain compaction.
+ *
+ * A square block of triangles is cut by a growing number of random
+ * holes with Terrain::nibble, and the fragmented polygons are then
+ * compacted. The polygon count before and after, the time taken and
+ * the change in area are reported. Coverage is checked by testing
+ * random points against both polygon sets: any disagreement is a
+ * mismatch.
+ *
+ * Each case is run without a minimum area (merging only, which should
+ * not change the coverage at all) and with the minimum area World uses,
+ * where slivers are dropped on purpose. A mismatch in a merge only case
+ * fails the benchmark.
+ *
+ * Compaction runs on the background worker, and World waits for it
+ * a fixed number of ticks after starting it. The time for a block
+ * of the default tile size gives the worst case per tile.
+ */
+namespace {
+
+// Same as COMPACTION_MIN_AREA in World
+const float MIN_AREA = 0.01f;
+const int SAMPLES = 100000;
+
+float area(const std::vector<ConvexPolygon> &polys)
+{
+    float a = 0;
+    for(const ConvexPolygon &p : polys) {
+        for(int i=0;i<p.vertexCount();++i)
+            a += p.vertex(i).x * p.vertex(i+1).y - p.vertex(i).y * p.vertex(i+1).x;
+    }
+    return a * 0.5f;
+}
+
+// A square block of triangles on a jittered lattice
+std::vector<ConvexPolygon> makeBlock(int size)
+{
+    std::mt19937 rng(size);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    const int stride = size + 1;
+    Points lattice;
+    for(int y=0;y<=size;++y)
+        for(int x=0;x<=size;++x)
+            lattice.push_back(Point(x + jitter(rng), y + jitter(rng)));
+
+    std::vector<ConvexPolygon> polys;
+    for(int y=0;y<size;++y) {
+        for(int x=0;x<size;++x) {
+            const Point &a = lattice[y * stride + x];
+            const Point &b = lattice[y * stride + x + 1];
+            const Point &c = lattice[(y+1) * stride + x + 1];
+            const Point &d = lattice[(y+1) * stride + x];
+            polys.push_back(ConvexPolygon(Points { a, b, c }));
+            polys.push_back(ConvexPolygon(Points { a, c, d }));
+        }
+    }
+    return polys;
+}
+
+std::vector<ConvexPolygon> makeHoles(int count, int size)
+{
+    std::mt19937 rng(count);
+    std::uniform_real_distribution<float> pos(0, size);
+    std::uniform_real_distribution<float> radius(0.2f, 2.0f);
+    std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+    std::uniform_int_distribution<int> sides(3, 12);
+
+    std::vector<ConvexPolygon> holes;
+    for(int i=0;i<count;++i) {
+        const Point c(pos(rng), pos(rng));
+        const float r = radius(rng);
+        const float a0 = angle(rng);
+        const int n = sides(rng);
+
+        Points points;
+        for(int s=0;s<n;++s) {
+            const float a = a0 + s * 2 * M_PI / n;
+            points.push_back(c + Point(std::cos(a), std::sin(a)) * r);
+        }
+        holes.push_back(ConvexPolygon(points));
+    }
+    return holes;
+}
+
+// Returns the number of coverage mismatches
+int compact(int size, int holes, float minarea)
+{
+    terrain::Terrain block(makeBlock(size));
+    for(const ConvexPolygon &hole : makeHoles(holes, size))
+        block.nibble(hole);
+
+    const std::vector<ConvexPolygon> before = block.polygons().toVector();
+
+    const uint64_t t0 = bench::now();
+    const std::vector<ConvexPolygon> after = terrain::compactPolygons(before, minarea);
+    const uint64_t t1 = bench::now();
+
+    // Coverage check
+    terrain::Terrain compacted(after);
+    std::mt19937 rng(holes);
+    std::uniform_real_distribution<float> pos(-1, size + 1);
+    int mismatches = 0;
+    for(int i=0;i<SAMPLES;++i) {
+        const Point p(pos(rng), pos(rng));
+        if(block.hasPoint(p) != compacted.hasPoint(p))
+            ++mismatches;
+    }
+
+    const float areabefore = area(before);
+    cout << std::setw(6) << size
+         << std::setw(8) << holes
+         << std::fixed << std::setprecision(2)
+         << std::setw(10) << minarea
+         << std::setw(10) << before.size()
+         << std::setw(10) << after.size()
+         << std::setprecision(3)
+         << std::setw(12) << (t1 - t0) / 1e6
+         << std::setprecision(4)
+         << std::setw(11) << 100.0 * (areabefore - area(after)) / areabefore << "%"
+         << std::setw(12) << mismatches
+         << "\n";
+
+    return mismatches;
+}
+
+int run(const std::vector<string> &args)
+{
+    const int maxholes = bench::intArg(args, 0, 400);
+    const int size = bench::intArg(args, 1, 40);
+    const int tilesize = bench::intArg(args, 2, 16);
+
+    cout << std::setw(6) << "size"
+         << std::setw(8) << "holes"
+         << std::setw(10) << "min area"
+         << std::setw(10) << "before"
+         << std::setw(10) << "after"
+         << std::setw(12) << "time ms"
+         << std::setw(12) << "area lost"
+         << std::setw(12) << "mismatches"
+         << "\n";
+
+    // Merging alone must not change the coverage. With the minimum
+    // area some mismatches are expected where slivers were dropped.
+    int mismatches = 0;
+    for(int holes=maxholes/4;holes<=maxholes;holes*=2) {
+        mismatches += compact(size, holes, 0);
+        compact(size, holes, MIN_AREA);
+    }
+
+    // The same hole density on a single tile
+    const int tileholes = maxholes * tilesize * tilesize / (size * size);
+    if(tileholes > 0) {
+        mismatches += compact(tilesize, tileholes, 0);
+        compact(tilesize, tileholes, MIN_AREA);
+    }
+
+    if(mismatches) {
+        cout << "MISMATCH: merging changed the coverage at " << mismatches << " points\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("compaction", "terrain compaction: polygon count, time and coverage [max holes] [block size] [tile size]", run);
+
+}
+
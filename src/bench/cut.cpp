@@ -0,0 +1,307 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cmath>
+
+#include "../terrain/terrain.h"
+#include "../util/threadpool.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::ConvexPolygon;
+using terrain::Point;
+using terrain::Points;
+
+/*
+ * Synchronous vs. background terrain cutting.
+ *
+ * A block of terrain split into tiles (like the level loader does)
+ * is bombarded with random holes every tick. The holes are cut the
+ * same way World does it: either synchronously with Terrain::nibble
+ * at the end of the tick, or with Terrain::startNibble and applied
+ * with Terrain::finishNibble a fixed number of ticks later. Holes
+ * hitting a tile that is still being cut wait for the next cut.
+ *
+ * Each tick also runs a parallelFor workload standing in for the
+ * physics step, and the ticks are paced at 60 per second like in the
+ * game, so the background worker gets the idle time at the end of
+ * each tick. The main thread time spent on the terrain and on the
+ * parallel loop is reported as percentiles over all ticks.
+ *
+ * Finally, the remaining cuts are applied and both terrains are
+ * checked against each other at random points. Any disagreement is
+ * a mismatch and fails the benchmark.
+ */
+namespace {
+
+const int SAMPLES = 100000;
+const unsigned int WORK_ITEMS = 4096;
+const unsigned int WORK_CHUNK = 16;
+const uint64_t TICK_NS = 1000000000 / 60;
+
+// A square tile of triangles on a jittered lattice
+std::vector<ConvexPolygon> makeTile(int x0, int y0, int size, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    const int stride = size + 1;
+    Points lattice;
+    for(int y=0;y<=size;++y) {
+        for(int x=0;x<=size;++x) {
+            // Keep the tile edges straight so tiles do not overlap
+            const float jx = (x == 0 || x == size) ? 0 : jitter(rng);
+            const float jy = (y == 0 || y == size) ? 0 : jitter(rng);
+            lattice.push_back(Point(x0 + x + jx, y0 + y + jy));
+        }
+    }
+
+    std::vector<ConvexPolygon> polys;
+    for(int y=0;y<size;++y) {
+        for(int x=0;x<size;++x) {
+            const Point &a = lattice[y * stride + x];
+            const Point &b = lattice[y * stride + x + 1];
+            const Point &c = lattice[(y+1) * stride + x + 1];
+            const Point &d = lattice[(y+1) * stride + x];
+            polys.push_back(ConvexPolygon(Points { a, b, c }));
+            polys.push_back(ConvexPolygon(Points { a, c, d }));
+        }
+    }
+    return polys;
+}
+
+typedef std::vector<std::unique_ptr<terrain::Terrain>> Tiles;
+
+Tiles makeTiles(int size, int tilesize)
+{
+    std::mt19937 rng(size);
+    Tiles tiles;
+    for(int y=0;y<size;y+=tilesize)
+        for(int x=0;x<size;x+=tilesize)
+            tiles.push_back(std::unique_ptr<terrain::Terrain>(new terrain::Terrain(makeTile(x, y, tilesize, rng))));
+    return tiles;
+}
+
+ConvexPolygon makeHole(std::mt19937 &rng, int size)
+{
+    std::uniform_real_distribution<float> pos(0, size);
+    std::uniform_real_distribution<float> radius(0.2f, 2.0f);
+    std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+    std::uniform_int_distribution<int> sides(3, 12);
+
+    const Point c(pos(rng), pos(rng));
+    const float r = radius(rng);
+    const float a0 = angle(rng);
+    const int n = sides(rng);
+
+    Points points;
+    for(int s=0;s<n;++s) {
+        const float a = a0 + s * 2 * M_PI / n;
+        points.push_back(c + Point(std::cos(a), std::sin(a)) * r);
+    }
+    return ConvexPolygon(points);
+}
+
+// Stand-in for the parallel physics loops
+float g_sink;
+void work()
+{
+    std::vector<float> out(WORK_ITEMS);
+    ThreadPool::parallelFor(0, WORK_ITEMS, WORK_CHUNK, [&out](unsigned int begin, unsigned int end) {
+        for(unsigned int i=begin;i<end;++i) {
+            float x = i;
+            for(int j=0;j<200;++j)
+                x = std::sqrt(x * x + j);
+            out[i] = x;
+        }
+    });
+    g_sink += out.back();
+}
+
+// The scheduling of World::finishHoles and World::startHoles
+class Cutter {
+public:
+    Cutter(Tiles &tiles, unsigned int delay)
+        : m_tiles(tiles), m_delay(delay), m_due(tiles.size()), m_pending(tiles.size())
+    { }
+
+    void finish(uint64_t tick)
+    {
+        for(unsigned int i=0;i<m_tiles.size();++i) {
+            if(m_tiles[i]->isCutting() && tick >= m_due[i])
+                m_tiles[i]->finishNibble();
+        }
+    }
+
+    void start(uint64_t tick, const std::vector<ConvexPolygon> &holes)
+    {
+        for(const ConvexPolygon &hole : holes) {
+            for(unsigned int i=0;i<m_tiles.size();++i) {
+                if(!m_tiles[i]->isEmpty() && m_tiles[i]->bounds().overlaps(hole.bounds()))
+                    m_pending[i].push_back(hole);
+            }
+        }
+
+        for(unsigned int i=0;i<m_tiles.size();++i) {
+            if(m_pending[i].empty() || m_tiles[i]->isCutting())
+                continue;
+
+            if(m_delay == 0)
+                m_tiles[i]->nibble(m_pending[i]);
+            else if(m_tiles[i]->startNibble(m_pending[i]))
+                m_due[i] = tick + m_delay;
+            m_pending[i].clear();
+        }
+    }
+
+    // Apply everything that is still queued
+    void flush(uint64_t tick)
+    {
+        while(true) {
+            bool busy = false;
+            for(unsigned int i=0;i<m_tiles.size();++i)
+                busy = busy || m_tiles[i]->isCutting() || !m_pending[i].empty();
+            if(!busy)
+                break;
+            finish(tick);
+            start(tick, std::vector<ConvexPolygon>());
+            tick += m_delay;
+        }
+    }
+
+private:
+    Tiles &m_tiles;
+    unsigned int m_delay;
+    std::vector<uint64_t> m_due;
+    std::vector<std::vector<ConvexPolygon>> m_pending;
+};
+
+void percentiles(const char *name, std::vector<uint64_t> &times)
+{
+    std::sort(times.begin(), times.end());
+    const double p[] = { 0.5, 0.9, 0.99, 1.0 };
+    cout << std::setw(12) << name;
+    for(double q : p) {
+        const unsigned int i = std::min<unsigned int>(times.size() - 1, q * times.size());
+        cout << std::setw(10) << times[i] / 1e6;
+    }
+    cout << "\n";
+}
+
+Tiles simulate(int size, int tilesize, int holes, int ticks, unsigned int delay)
+{
+    Tiles tiles = makeTiles(size, tilesize);
+    Cutter cutter(tiles, delay);
+    std::mt19937 rng(holes);
+
+    std::vector<uint64_t> worktimes, terraintimes;
+    std::vector<ConvexPolygon> tickholes;
+    for(int tick=0;tick<ticks;++tick) {
+        tickholes.clear();
+        for(int i=0;i<holes;++i)
+            tickholes.push_back(makeHole(rng, size));
+
+        const uint64_t t0 = bench::now();
+        work();
+        const uint64_t t1 = bench::now();
+        cutter.finish(tick);
+        cutter.start(tick, tickholes);
+        const uint64_t t2 = bench::now();
+
+        worktimes.push_back(t1 - t0);
+        terraintimes.push_back(t2 - t1);
+
+        if(t2 - t0 < TICK_NS)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(TICK_NS - (t2 - t0)));
+    }
+
+    cutter.flush(ticks);
+
+    cout << (delay == 0 ? "synchronous" : "background") << " (delay " << delay << " ticks), ms:\n";
+    cout << std::fixed << std::setprecision(3)
+         << std::setw(12) << ""
+         << std::setw(10) << "p50"
+         << std::setw(10) << "p90"
+         << std::setw(10) << "p99"
+         << std::setw(10) << "max"
+         << "\n";
+    percentiles("parallelFor", worktimes);
+    percentiles("terrain", terraintimes);
+    cout.unsetf(std::ios::floatfield);
+
+    return tiles;
+}
+
+bool hasPoint(const Tiles &tiles, const Point &p)
+{
+    for(const std::unique_ptr<terrain::Terrain> &t : tiles)
+        if(t->hasPoint(p))
+            return true;
+    return false;
+}
+
+int run(const std::vector<string> &args)
+{
+    const int holes = bench::intArg(args, 0, 4);
+    const int delay = bench::intArg(args, 1, 4);
+    const int ticks = bench::intArg(args, 2, 300);
+    const int size = bench::intArg(args, 3, 48);
+    const int tilesize = bench::intArg(args, 4, 16);
+
+    if(delay < 1 || tilesize < 1 || size < tilesize) {
+        std::cerr << "Invalid arguments\n";
+        return 1;
+    }
+
+    ThreadPool::initSingleton();
+
+    cout << ticks << " ticks, " << holes << " holes per tick, "
+         << size << "x" << size << " block in " << tilesize << "x" << tilesize << " tiles\n";
+
+    const Tiles sync = simulate(size, tilesize, holes, ticks, 0);
+    const Tiles async = simulate(size, tilesize, holes, ticks, delay);
+
+    ThreadPool::shutdownSingleton();
+
+    // Coverage check
+    std::mt19937 rng(size);
+    std::uniform_real_distribution<float> pos(-1, size + 1);
+    int mismatches = 0;
+    for(int i=0;i<SAMPLES;++i) {
+        const Point p(pos(rng), pos(rng));
+        if(hasPoint(sync, p) != hasPoint(async, p))
+            ++mismatches;
+    }
+    cout << "mismatches: " << mismatches << " of " << SAMPLES << " points\n";
+
+    if(mismatches) {
+        cout << "MISMATCH: synchronous and background cuts differ\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("cut", "synchronous vs. background terrain cutting, per tick times and coverage [holes per tick] [delay] [ticks] [block size] [tile size]", run);
+
+}
@@ -0,0 +1,144 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include "../physics.h"
+#include "../world.h"
+#include "../projectile/projectilestore.h"
+#include "../util/threadpool.h"
+#include "bench.h"
+
+using std::cout;
+
+/*
+ * Projectile integration: scalar Physical::step vs. the SIMD
+ * batch integrator in ProjectileStore.
+ *
+ * The world has no terrain, so this measures just the integrator
+ * and the per-object overhead around it. Both paths start from the same
+ * state and the final positions are compared.
+ *
+ * The batch integrator is also run on the thread pool. Its results
+ * must be bit-identical to the single threaded run.
+ */
+namespace {
+
+const int TICKS = 100;
+
+int run(const std::vector<string> &args)
+{
+    std::vector<int> counts;
+    for(const string &a : args)
+        counts.push_back(atoi(a.c_str()));
+    if(counts.empty()) {
+        counts.push_back(10000);
+        counts.push_back(100000);
+    }
+
+    World world;
+    world.setBounds(terrain::BRect(-10000, -10000, 20000, 20000));
+    terrain::ZoneProps root;
+    root.gravity = glm::vec2(0, -9.81f);
+    root.force = glm::vec2(0.5f, 0);
+    root.density = 1.2f;
+    world.setRootZone(root);
+
+    cout << std::setw(10) << "bullets"
+         << std::setw(16) << "scalar ns/obj"
+         << std::setw(16) << "batch ns/obj"
+         << std::setw(16) << "threads ns/obj"
+         << std::setw(10) << "speedup"
+         << std::setw(14) << "max error"
+         << "\n";
+
+    for(int count : counts) {
+        std::mt19937 rng(count);
+        std::uniform_real_distribution<float> pos(-1000, 1000);
+        std::uniform_real_distribution<float> vel(-50, 50);
+
+        std::vector<Physical> scalar;
+        ProjectileStore batch(count), parallel(count);
+        std::vector<PoolHandle> handles;
+        std::vector<CollisionEvent> events;
+        for(int i=0;i<count;++i) {
+            Physical p(10.0f, 0.05f, glm::vec2(pos(rng), pos(rng)), glm::vec2(vel(rng), vel(rng)));
+            p.addImpulse(glm::vec2(vel(rng), vel(rng)));
+            scalar.push_back(p);
+            handles.push_back(batch.add(nullptr, p, TICKS * 2));
+            parallel.add(nullptr, p, TICKS * 2);
+        }
+
+        uint64_t t0 = bench::now();
+        for(int tick=0;tick<TICKS;++tick) {
+            for(Physical &p : scalar)
+                p.step(world);
+        }
+        uint64_t t1 = bench::now();
+        for(int tick=0;tick<TICKS;++tick)
+            batch.step(world, events);
+        uint64_t t2 = bench::now();
+
+        ThreadPool::initSingleton();
+        uint64_t t3 = bench::now();
+        for(int tick=0;tick<TICKS;++tick)
+            parallel.step(world, events);
+        uint64_t t4 = bench::now();
+        ThreadPool::shutdownSingleton();
+
+        for(unsigned int i=0;i<batch.size();++i) {
+            if(batch.position(i) != parallel.position(i) || batch.velocity(i) != parallel.velocity(i)) {
+                cout << "projectile " << i << " differs between single and multithreaded runs!\n";
+                return 1;
+            }
+        }
+
+        float maxerr = 0;
+        for(int i=0;i<count;++i) {
+            int j = batch.indexOf(handles[i]);
+            if(j < 0) {
+                cout << "projectile " << i << " was unexpectedly removed!\n";
+                return 1;
+            }
+            glm::vec2 d = batch.position(j) - scalar[i].position();
+            maxerr = std::max(maxerr, std::max(std::fabs(d.x), std::fabs(d.y)));
+        }
+
+        const double scalar_ns = double(t1 - t0) / TICKS / count;
+        const double batch_ns = double(t2 - t1) / TICKS / count;
+        const double parallel_ns = double(t4 - t3) / TICKS / count;
+
+        cout << std::setw(10) << count
+             << std::fixed << std::setprecision(2)
+             << std::setw(16) << scalar_ns
+             << std::setw(16) << batch_ns
+             << std::setw(16) << parallel_ns
+             << std::setw(9) << scalar_ns / batch_ns << "x"
+             << std::scientific << std::setprecision(2)
+             << std::setw(14) << maxerr
+             << std::fixed << "\n";
+    }
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("integrator", "scalar vs. batch projectile integration [bullet counts...]", run);
+
+}
+
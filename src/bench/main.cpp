@@ -0,0 +1,83 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include "bench.h"
+
+using std::cout;
+using std::cerr;
+
+namespace bench {
+
+namespace {
+    std::vector<const Benchmark*> &registry()
+    {
+        static std::vector<const Benchmark*> benchmarks;
+        return benchmarks;
+    }
+}
+
+Benchmark::Benchmark(const string &name, const string &description, BenchFunction fn)
+    : m_name(name), m_description(description), m_fn(fn)
+{
+    registry().push_back(this);
+}
+
+const std::vector<const Benchmark*> &Benchmark::all()
+{
+    return registry();
+}
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int intArg(const std::vector<string> &args, unsigned int i, int def)
+{
+    if(i < args.size())
+        return atoi(args[i].c_str());
+    return def;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2) {
+        cerr << "Usage: " << argv[0] << " <benchmark> [arguments]\n\nAvailable benchmarks:\n";
+        for(const bench::Benchmark *b : bench::Benchmark::all())
+            cerr << "  " << b->name() << "\t" << b->description() << "\n";
+        return 1;
+    }
+
+    const string name = argv[1];
+    std::vector<string> args(argv + 2, argv + argc);
+
+    for(const bench::Benchmark *b : bench::Benchmark::all()) {
+        if(b->name() == name)
+            return b->run(args);
+    }
+
+    cerr << "No such benchmark: " << name << "\n";
+    return 1;
+}
+
@@ -0,0 +1,201 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+
+#include "../terrain/polygon.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::ConvexPolygon;
+using terrain::PolygonView;
+using terrain::Point;
+using terrain::Points;
+
+/*
+ * Polygon overlap test (separating axis theorem.)
+ *
+ * Terrain pieces are produced the same way as in the game: a block
+ * of triangles is cut by random holes with booleanDifference. Then
+ * a new set of holes is tested against every piece whose bounding box
+ * it touches, which is what nibble does to find the polygons to cut.
+ *
+ * The old one-sided test (only this polygon's axes), the scalar
+ * two-sided test and the SIMD version are timed on the same pairs.
+ * The SIMD results must match the scalar ones exactly. The one-sided
+ * test can report overlaps that are not there.
+ */
+namespace {
+
+const int BLOCK_SIZE = 20;
+const int ROUNDS = 50;
+
+// The overlap test as it was before: only this polygon's normals are tested
+bool oneSided(const PolygonView &a, const PolygonView &b)
+{
+    if(!a.bounds().overlaps(b.bounds()))
+        return false;
+
+    for(int i=0;i<a.vertexCount();++i) {
+        const glm::vec2 &axis = a.normal(i);
+        float amin, amax, bmin, bmax;
+        amin = amax = glm::dot(a.vertex(0), axis);
+        for(int j=1;j<a.vertexCount();++j) {
+            const float f = glm::dot(a.vertex(j), axis);
+            amin = std::min(amin, f);
+            amax = std::max(amax, f);
+        }
+        bmin = bmax = glm::dot(b.vertex(0), axis);
+        for(int j=1;j<b.vertexCount();++j) {
+            const float f = glm::dot(b.vertex(j), axis);
+            bmin = std::min(bmin, f);
+            bmax = std::max(bmax, f);
+        }
+        if(!(amin < bmax && amax > bmin))
+            return false;
+    }
+    return true;
+}
+
+ConvexPolygon makeHole(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> pos(0, BLOCK_SIZE);
+    std::uniform_real_distribution<float> radius(0.3f, 1.5f);
+    std::uniform_real_distribution<float> angle(0, 2 * M_PI);
+    std::uniform_int_distribution<int> sides(3, 10);
+
+    const Point c(pos(rng), pos(rng));
+    const float r = radius(rng);
+    const float a0 = angle(rng);
+    const int n = sides(rng);
+
+    Points points;
+    for(int s=0;s<n;++s) {
+        const float a = a0 + s * 2 * M_PI / n;
+        points.push_back(c + Point(std::cos(a), std::sin(a)) * r);
+    }
+    return ConvexPolygon(points);
+}
+
+// A block of triangles riddled with holes
+std::vector<ConvexPolygon> makePieces(std::mt19937 &rng, int holes)
+{
+    std::vector<ConvexPolygon> polys, next;
+    for(int y=0;y<BLOCK_SIZE;++y) {
+        for(int x=0;x<BLOCK_SIZE;++x) {
+            const Point a(x, y), b(x+1, y), c(x+1, y+1), d(x, y+1);
+            polys.push_back(ConvexPolygon(Points { a, b, c }));
+            polys.push_back(ConvexPolygon(Points { a, c, d }));
+        }
+    }
+
+    for(int h=0;h<holes;++h) {
+        const ConvexPolygon hole = makeHole(rng);
+        next.clear();
+        for(const ConvexPolygon &p : polys) {
+            if(p.overlaps(hole))
+                p.booleanDifference(hole, next);
+            else
+                next.push_back(p);
+        }
+        polys.swap(next);
+    }
+    return polys;
+}
+
+int run(const std::vector<string> &args)
+{
+    const int holes = bench::intArg(args, 0, 200);
+
+    std::mt19937 rng(holes);
+    const std::vector<ConvexPolygon> pieces = makePieces(rng, holes);
+
+    // Pairs whose bounding boxes touch
+    std::vector<std::pair<const ConvexPolygon*, ConvexPolygon>> pairs;
+    for(int h=0;h<holes;++h) {
+        const ConvexPolygon hole = makeHole(rng);
+        for(const ConvexPolygon &p : pieces) {
+            if(p.bounds().overlaps(hole.bounds()))
+                pairs.push_back(std::make_pair(&p, hole));
+        }
+    }
+
+    unsigned int vertices = 0;
+    for(const ConvexPolygon &p : pieces)
+        vertices += p.vertexCount();
+
+    cout << pieces.size() << " pieces with " << float(vertices) / pieces.size()
+         << " vertices on average, " << pairs.size() << " pairs\n";
+
+    std::vector<char> onesided(pairs.size()), scalar(pairs.size()), simd(pairs.size());
+
+    // Warm up
+    for(unsigned int i=0;i<pairs.size();++i)
+        scalar[i] = oneSided(*pairs[i].first, pairs[i].second) ^
+            PolygonView(*pairs[i].first).overlapsScalar(pairs[i].second) ^
+            pairs[i].first->overlaps(pairs[i].second);
+
+    uint64_t t0 = bench::now();
+    for(int r=0;r<ROUNDS;++r)
+        for(unsigned int i=0;i<pairs.size();++i)
+            onesided[i] = oneSided(*pairs[i].first, pairs[i].second);
+    uint64_t t1 = bench::now();
+    for(int r=0;r<ROUNDS;++r)
+        for(unsigned int i=0;i<pairs.size();++i)
+            scalar[i] = PolygonView(*pairs[i].first).overlapsScalar(pairs[i].second);
+    uint64_t t2 = bench::now();
+    for(int r=0;r<ROUNDS;++r)
+        for(unsigned int i=0;i<pairs.size();++i)
+            simd[i] = pairs[i].first->overlaps(pairs[i].second);
+    uint64_t t3 = bench::now();
+
+    int mismatches = 0, falsepositives = 0, overlapping = 0;
+    for(unsigned int i=0;i<pairs.size();++i) {
+        if(simd[i] != scalar[i])
+            ++mismatches;
+        if(onesided[i] && !scalar[i])
+            ++falsepositives;
+        if(scalar[i])
+            ++overlapping;
+    }
+
+    const double tests = double(ROUNDS) * pairs.size();
+    const double scalar_ns = (t2 - t1) / tests;
+    const double simd_ns = (t3 - t2) / tests;
+
+    cout << std::fixed << std::setprecision(1)
+         << std::setw(12) << "one-sided" << std::setw(10) << (t1 - t0) / tests << " ns/test\n"
+         << std::setw(12) << "scalar" << std::setw(10) << scalar_ns << " ns/test\n"
+         << std::setw(12) << "simd" << std::setw(10) << simd_ns << " ns/test ("
+         << scalar_ns / simd_ns << "x)\n\n"
+         << overlapping << " overlapping pairs, "
+         << falsepositives << " false positives from the one-sided test\n";
+
+    if(mismatches) {
+        cout << "MISMATCH: SIMD and scalar results differ for " << mismatches << " pairs\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("sat", "polygon overlap test: one-sided vs. scalar vs. SIMD [holes]", run);
+
+}
@@ -0,0 +1,173 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "../fs/paths.h"
+#include "../res/resources.h"
+#include "../level/levels.h"
+#include "../projectile/projectiledef.h"
+#include "../util/threadpool.h"
+#include "../gameinit.h"
+#include "../game.h"
+#include "../world.h"
+#include "bench.h"
+
+using std::cout;
+using std::cerr;
+
+/*
+ * Full simulation tick.
+ *
+ * The game data is loaded in headless mode and the world is set up
+ * from a quicklaunch file. The player ship is then cloned until
+ * the requested number of ships is in play, and projectiles are
+ * topped up before every tick so the projectile count stays constant.
+ *
+ * Explosions can be added by making the given number of random holes
+ * in the terrain every tick. The terrain cut delay can be set to compare
+ * synchronous cutting (0) with background cutting (see World::setCutDelay.)
+ *
+ * Run from the source directory, so the data directory and the
+ * launch file are found.
+ */
+namespace {
+
+const char *PROJECTILE = "blastingbolt";
+
+void percentile(const char *name, const std::vector<uint64_t> &sorted, double p)
+{
+    const unsigned int i = std::min<unsigned int>(sorted.size() - 1, p * sorted.size());
+    cout << std::setw(8) << name << std::setw(12) << sorted[i] << " ns\n";
+}
+
+int run(const std::vector<string> &args)
+{
+    const int ships = bench::intArg(args, 0, 4);
+    const int projectiles = bench::intArg(args, 1, 2000);
+    const int ticks = bench::intArg(args, 2, 1000);
+    const string launchfile = args.size() > 3 ? args[3] : "test.launch";
+    const int holes = bench::intArg(args, 4, 0);
+    const int cutdelay = bench::intArg(args, 5, -1);
+
+    if(ships < 1 || ticks < 1) {
+        cerr << "At least one ship and one tick is needed\n";
+        return 1;
+    }
+
+    // Load game data
+    if(!fs::Paths::init("data"))
+        return 1;
+
+    resource::Resources::getInstance().setHeadless(true);
+    level::LevelRegistry::init();
+    if(!loadGame("game.data"))
+        return 1;
+
+    gameinit::Hotseat launcher = gameinit::Hotseat::loadFromFile(launchfile);
+    ThreadPool::initSingleton();
+
+    World world;
+    launcher.initialize(world);
+
+    Ship *player = world.getPlayerShip(1);
+    if(!player) {
+        cerr << launchfile << " does not define player 1\n";
+        return 1;
+    }
+
+    // Clone the player ship
+    const terrain::BRect &bounds = world.bounds();
+    std::mt19937 rng(ships);
+    std::uniform_real_distribution<float> xpos(bounds.left(), bounds.right());
+    std::uniform_real_distribution<float> ypos(bounds.bottom(), bounds.top());
+    std::uniform_real_distribution<float> vel(-10, 10);
+
+    const Ship proto = *player;
+    for(int i=1;i<ships;++i) {
+        Ship s = proto;
+        s.physics().setPosition(glm::vec2(xpos(rng), ypos(rng)));
+        s.physics().setVelocity(glm::vec2(vel(rng), vel(rng)));
+        world.addShip(s);
+    }
+
+    const ProjectileDef *pdef = Projectiles::get(PROJECTILE);
+
+    if(cutdelay >= 0)
+        world.setCutDelay(cutdelay);
+
+    std::uniform_real_distribution<float> holeradius(0.2f, 1.0f);
+    std::uniform_real_distribution<float> holeangle(0, 2 * M_PI);
+
+    cout << "Running " << ticks << " ticks with " << ships << " ships and "
+         << projectiles << " projectiles\n";
+    if(holes > 0)
+        cout << holes << " holes per tick, cut delay " << world.cutDelay() << " ticks\n";
+
+    std::vector<uint64_t> times;
+    times.reserve(ticks);
+    for(int tick=0;tick<ticks;++tick) {
+        while(world.projectiles().size() < unsigned(projectiles)) {
+            if(world.addProjectile(Projectile(pdef,
+                glm::vec2(xpos(rng), ypos(rng)),
+                glm::vec2(vel(rng), vel(rng)) * 5.0f)).isNull())
+                break;
+        }
+
+        for(int i=0;i<holes;++i) {
+            const terrain::Point c(xpos(rng), ypos(rng));
+            const float r = holeradius(rng);
+            const float a0 = holeangle(rng);
+            terrain::Points points;
+            for(int j=0;j<8;++j) {
+                const float a = a0 + j * M_PI / 4;
+                points.push_back(c + terrain::Point(std::cos(a), std::sin(a)) * r);
+            }
+            world.makeHole(terrain::ConvexPolygon(points));
+        }
+
+        const uint64_t t0 = bench::now();
+        world.step();
+        times.push_back(bench::now() - t0);
+    }
+
+    ThreadPool::shutdownSingleton();
+
+    uint64_t total = 0;
+    for(uint64_t t : times)
+        total += t;
+
+    std::sort(times.begin(), times.end());
+
+    cout << std::setw(8) << "mean" << std::setw(12) << total / times.size() << " ns\n";
+    percentile("min", times, 0.0);
+    percentile("p50", times, 0.50);
+    percentile("p90", times, 0.90);
+    percentile("p99", times, 0.99);
+    percentile("max", times, 1.0);
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("tick", "World::step with full game data [ships] [projectiles] [ticks] [launch file] [holes per tick] [cut delay]", run);
+
+}
+
@@ -0,0 +1,200 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "../terrain/algorithm.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::Point;
+using terrain::Points;
+namespace algorithm = terrain::algorithm;
+
+/*
+ * Polygon triangulation and partitioning scaling.
+ *
+ * A cave-like outline is generated with a growing number of vertices
+ * and triangulated with both the old flipcode ear clipper (kept here
+ * for reference) and the current one. The time taken by fastPartition,
+ * which is what level loading and hole cutting actually call,
+ * is shown too.
+ */
+namespace {
+
+const float EPSILON = 0.0000000001f;
+
+// Outlines with fewer vertices than this are triangulated repeatedly
+const int REPEAT_VERTICES = 16384;
+
+// The original triangulator, which tests every remaining vertex
+// for every candidate ear and shifts the vertex array on every clip.
+bool oldSnip(const Points &contour, int u, int v, int w, int n, const std::vector<int> &V)
+{
+    const Point &A = contour[V[u]];
+    const Point &B = contour[V[v]];
+    const Point &C = contour[V[w]];
+
+    if(EPSILON > (((B.x-A.x) * (C.y-A.y)) - ((B.y-A.y) * (C.x-A.x))))
+        return false;
+
+    for(int p=0;p<n;p++) {
+        if((p == u) || (p == v) || (p == w))
+            continue;
+        if(algorithm::pointInTriangle(A, B, C, contour[V[p]]))
+            return false;
+    }
+    return true;
+}
+
+std::vector<Points> oldTriangulate(const Points &contour)
+{
+    int nv = contour.size();
+    std::vector<int> V(nv);
+    for(int v=0;v<nv;v++)
+        V[v] = v;
+
+    std::vector<Points> triangles;
+    int count = 2*nv;
+    for(int v=nv-1;nv>2;) {
+        if(0 >= (count--))
+            break;
+
+        int u = v;
+        if(nv <= u)
+            u = 0;
+        v = u+1;
+        if(nv <= v)
+            v = 0;
+        int w = v+1;
+        if(nv <= w)
+            w = 0;
+
+        if(oldSnip(contour, u, v, w, nv, V)) {
+            triangles.push_back(Points { contour[V[u]], contour[V[v]], contour[V[w]] });
+            for(int s=v,t=v+1;t<nv;s++,t++)
+                V[s] = V[t];
+            nv--;
+            count = 2*nv;
+        }
+    }
+    return triangles;
+}
+
+float area(const Points &points)
+{
+    float a = 0;
+    for(unsigned int i=0;i<points.size();++i) {
+        const Point &p = points[i];
+        const Point &q = points[(i+1) % points.size()];
+        a += p.x * q.y - p.y * q.x;
+    }
+    return a * 0.5f;
+}
+
+// A star shaped, counterclockwise outline with a rough wall
+Points makeOutline(int vertices)
+{
+    std::mt19937 rng(vertices);
+    std::uniform_real_distribution<float> phase(0, 2 * M_PI);
+    std::uniform_real_distribution<float> rough(-0.5f, 0.5f);
+
+    const float p1 = phase(rng), p2 = phase(rng), p3 = phase(rng);
+
+    Points outline;
+    for(int i=0;i<vertices;++i) {
+        const float a = i * 2 * M_PI / vertices;
+        const float r = 100.0f
+            + 30.0f * std::sin(3 * a + p1)
+            + 15.0f * std::sin(7 * a + p2)
+            + 5.0f * std::sin(31 * a + p3)
+            + rough(rng);
+        outline.push_back(Point(std::cos(a), std::sin(a)) * r);
+    }
+    return outline;
+}
+
+int run(const std::vector<string> &args)
+{
+    const int maxvertices = bench::intArg(args, 0, 8192);
+
+    cout << std::setw(10) << "vertices"
+         << std::setw(14) << "old us"
+         << std::setw(14) << "new us"
+         << std::setw(10) << "speedup"
+         << std::setw(16) << "partition us"
+         << std::setw(10) << "convex"
+         << "\n";
+
+    bool failed = false;
+    for(int n=16;n<=maxvertices;n*=2) {
+        const Points outline = makeOutline(n);
+
+        // Small outlines are repeated to get measurable times
+        const int reps = std::max(1, REPEAT_VERTICES / n);
+        std::vector<Points> oldtris, tris, parts;
+
+        uint64_t t0 = bench::now();
+        for(int i=0;i<reps;++i)
+            oldtris = oldTriangulate(outline);
+        uint64_t t1 = bench::now();
+        for(int i=0;i<reps;++i)
+            tris = algorithm::triangulate(outline);
+        uint64_t t2 = bench::now();
+        for(int i=0;i<reps;++i)
+            parts = algorithm::fastPartition(outline);
+        uint64_t t3 = bench::now();
+
+        const double old_us = (t1 - t0) / 1e3 / reps;
+        const double new_us = (t2 - t1) / 1e3 / reps;
+
+        float triarea = 0, partarea = 0;
+        for(const Points &t : tris)
+            triarea += area(t);
+        for(const Points &p : parts)
+            partarea += area(p);
+
+        cout << std::setw(10) << n
+             << std::fixed << std::setprecision(1)
+             << std::setw(14) << old_us
+             << std::setw(14) << new_us
+             << std::setw(9) << old_us / new_us << "x"
+             << std::setw(16) << (t3 - t2) / 1e3 / reps
+             << std::setw(10) << parts.size();
+
+        if(int(tris.size()) != n - 2 || int(oldtris.size()) != n - 2) {
+            cout << " BAD TRIANGLE COUNT (old " << oldtris.size() << ", new " << tris.size() << ")";
+            failed = true;
+        }
+        const float total = area(outline);
+        if(std::fabs(triarea - total) > 1e-3f * total || std::fabs(partarea - total) > 1e-3f * total) {
+            cout << " AREA MISMATCH";
+            failed = true;
+        }
+        cout << "\n";
+    }
+
+    return failed ? 1 : 0;
+}
+
+bench::Benchmark BENCHMARK("triangulate", "polygon triangulation time vs. outline vertex count [max vertices]", run);
+
+}
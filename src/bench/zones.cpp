@@ -0,0 +1,192 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <memory>
+#include <cmath>
+
+#include "../terrain/terrains.h"
+#include "../terrain/tiles.h"
+#include "../terrain/zoneindex.h"
+#include "bench.h"
+
+using std::cout;
+using terrain::ConvexPolygon;
+using terrain::Point;
+using terrain::Points;
+
+/*
+ * Zone lookups on tiled zone blocks.
+ *
+ * A big zone block is split into tiles the way the level loader does it
+ * and put in a single zone. Points exactly on the tile seams (inside two
+ * or four pieces) and random points are looked up with ZoneIndex. The
+ * result must match the unindexed lookup, and the zone must be applied
+ * at most once. Any difference is an error. Points that are inside the
+ * original block must get the zone, except right at its outer edge,
+ * where the clipped pieces may round differently.
+ *
+ * The lookup time is compared with the same block in one piece. Cells
+ * straddling a seam are still covered by the zone as a whole, so the
+ * tiled block should be just as fast.
+ */
+namespace {
+
+const int SAMPLES = 1000000;
+const glm::vec2 FORCE(1.0f, 2.0f);
+const float DENSITY = 1000.0f;
+
+// A big slanted quadrilateral
+std::vector<ConvexPolygon> makeBlock(float size)
+{
+    return std::vector<ConvexPolygon>(1, ConvexPolygon(Points {
+        Point(size * 0.05f, size * 0.1f),
+        Point(size * 0.9f, size * 0.05f),
+        Point(size * 0.95f, size * 0.9f),
+        Point(size * 0.1f, size * 0.95f)
+    }));
+}
+
+std::unique_ptr<terrain::Zone> makeZone(const std::vector<ConvexPolygon> &polygons)
+{
+    std::unique_ptr<terrain::Zone> zone(new terrain::Zone(polygons));
+    zone->setZoneForce(FORCE);
+    zone->setZoneDensity(DENSITY);
+    return zone;
+}
+
+bool sameProps(const terrain::ZoneProps &a, const terrain::ZoneProps &b)
+{
+    return a.force == b.force && a.density == b.density;
+}
+
+// Look up the points and count the wrong answers
+int check(const terrain::ZoneIndex &index, const terrain::Zone &zone, const ConvexPolygon &block,
+    const std::vector<Point> &points, const terrain::ZoneProps &root)
+{
+    terrain::ZoneProps inside = root;
+    zone.apply(inside);
+
+    // The block shrunk a little, to leave out points on its outer edge
+    const Point c = (block.bounds().btmleft() + block.bounds().topright()) * 0.5f;
+    terrain::Points shrunk;
+    for(int i=0;i<block.vertexCount();++i)
+        shrunk.push_back(c + (block.vertex(i) - c) * 0.999f);
+    const ConvexPolygon core(shrunk);
+
+    int errors = 0;
+    for(const Point &p : points) {
+        const terrain::ZoneProps zp = index.zoneAt(p, root);
+        terrain::ZoneProps slow = root;
+        if(zone.hasPoint(p))
+            zone.apply(slow);
+
+        if(!sameProps(zp, slow))
+            ++errors;
+        else if(!sameProps(zp, inside) && (!sameProps(zp, root) || core.hasPoint(p)))
+            ++errors;
+    }
+    return errors;
+}
+
+double lookupTime(const terrain::ZoneIndex &index, const std::vector<Point> &points, const terrain::ZoneProps &root)
+{
+    float sink = 0;
+    const uint64_t t0 = bench::now();
+    for(const Point &p : points)
+        sink += index.zoneAt(p, root).force.x;
+    const uint64_t t1 = bench::now();
+
+    if(sink < 0)
+        cout << "";
+    return double(t1 - t0) / points.size();
+}
+
+int run(const std::vector<string> &args)
+{
+    const int size = bench::intArg(args, 0, 4096);
+    const int tilesize = bench::intArg(args, 1, 16);
+
+    if(size < 1 || tilesize < 1) {
+        std::cerr << "Invalid arguments\n";
+        return 1;
+    }
+
+    const std::vector<ConvexPolygon> block = makeBlock(size);
+    const terrain::BRect bounds(Point(0, 0), Point(size, size));
+
+    terrain::ZoneProps root;
+    root.gravity = glm::vec2(0, -9.81f);
+    root.density = 1.2f;
+
+    std::vector<ConvexPolygon> pieces;
+    for(const std::vector<ConvexPolygon> &tile : terrain::splitTiles(block, tilesize))
+        pieces.insert(pieces.end(), tile.begin(), tile.end());
+
+    std::unique_ptr<terrain::Zone> whole = makeZone(block);
+    std::unique_ptr<terrain::Zone> tiled = makeZone(pieces);
+
+    terrain::ZoneIndex wholeindex, tiledindex;
+    uint64_t t0 = bench::now();
+    wholeindex.build(std::vector<terrain::Zone*>(1, whole.get()), bounds);
+    uint64_t t1 = bench::now();
+    tiledindex.build(std::vector<terrain::Zone*>(1, tiled.get()), bounds);
+    uint64_t t2 = bench::now();
+
+    cout << size << "x" << size << " level, " << tilesize << "x" << tilesize << " tiles, "
+         << pieces.size() << " pieces\n";
+    cout << std::fixed << std::setprecision(1)
+         << "index build: whole " << (t1 - t0) / 1e6 << " ms, tiled " << (t2 - t1) / 1e6 << " ms\n";
+
+    // Points on the seams and on the seam crossings
+    std::mt19937 rng(size);
+    std::uniform_real_distribution<float> pos(0, size);
+    std::vector<Point> seams;
+    for(int s=tilesize;s<size;s+=tilesize) {
+        const float t = pos(rng);
+        seams.push_back(Point(s, t));
+        seams.push_back(Point(t, s));
+        for(int u=tilesize;u<size;u+=tilesize * 16)
+            seams.push_back(Point(s, u));
+    }
+
+    std::vector<Point> points;
+    for(int i=0;i<SAMPLES;++i)
+        points.push_back(Point(pos(rng), pos(rng)));
+
+    const int seamerrors = check(tiledindex, *tiled, block[0], seams, root);
+    const int errors = check(tiledindex, *tiled, block[0], points, root);
+
+    cout << "seam points: " << seams.size() << ", errors " << seamerrors << "\n";
+    cout << "random points: " << points.size() << ", errors " << errors << "\n";
+    cout << "lookup: whole " << lookupTime(wholeindex, points, root)
+         << " ns, tiled " << lookupTime(tiledindex, points, root) << " ns\n";
+    cout.unsetf(std::ios::floatfield);
+
+    if(seamerrors || errors) {
+        cout << "MISMATCH: zone lookups differ from the expected result\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+bench::Benchmark BENCHMARK("zones", "zone lookups on a tiled zone block, with points on the tile seams [level size] [tile size]", run);
+
+}
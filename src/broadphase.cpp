@@ -0,0 +1,126 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cmath>
+
+#include "broadphase.h"
+
+namespace {
+    // Smallest allowed cell size. This keeps the number of cells
+    // per object sane even if all the objects are tiny.
+    const float MIN_CELL_SIZE = 0.5f;
+
+    // Below this many objects, building the grid costs more
+    // than just testing every pair.
+    const unsigned int MIN_GRID_OBJECTS = 64;
+
+    uint64_t cellKey(int x, int y)
+    {
+        return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+    }
+}
+
+Broadphase::Broadphase()
+    : m_maxradius(0)
+{
+}
+
+void Broadphase::clear()
+{
+    m_objects.clear();
+    m_maxradius = 0;
+}
+
+void Broadphase::add(const glm::vec2 &pos, float radius)
+{
+    Object o = { pos, radius };
+    m_objects.push_back(o);
+    if(radius > m_maxradius)
+        m_maxradius = radius;
+}
+
+bool Broadphase::boxesOverlap(const Object &a, const Object &b)
+{
+    const float r = a.radius + b.radius;
+    return std::fabs(a.pos.x - b.pos.x) <= r && std::fabs(a.pos.y - b.pos.y) <= r;
+}
+
+void Broadphase::findPairs(std::vector<Pair> &pairs)
+{
+    pairs.clear();
+    m_cells.clear();
+
+    if(m_objects.size() < 2)
+        return;
+
+    if(m_objects.size() < MIN_GRID_OBJECTS) {
+        for(unsigned int i=0;i<m_objects.size();++i) {
+            for(unsigned int j=i+1;j<m_objects.size();++j) {
+                if(boxesOverlap(m_objects[i], m_objects[j]))
+                    pairs.push_back(Pair(i, j));
+            }
+        }
+        return;
+    }
+
+    // Make cells big enough so that even the largest object
+    // touches at most 2x2 cells.
+    const float cellsize = std::max(m_maxradius * 2.0f, MIN_CELL_SIZE);
+    const float inv = 1.0f / cellsize;
+
+    // Place the objects in all the cells their bounding boxes touch
+    for(unsigned int i=0;i<m_objects.size();++i) {
+        const Object &o = m_objects[i];
+        const int x0 = int(std::floor((o.pos.x - o.radius) * inv));
+        const int x1 = int(std::floor((o.pos.x + o.radius) * inv));
+        const int y0 = int(std::floor((o.pos.y - o.radius) * inv));
+        const int y1 = int(std::floor((o.pos.y + o.radius) * inv));
+
+        for(int x=x0;x<=x1;++x) {
+            for(int y=y0;y<=y1;++y) {
+                CellEntry e = { cellKey(x, y), i };
+                m_cells.push_back(e);
+            }
+        }
+    }
+
+    // Sorting groups together the objects in the same cell.
+    // Inside a cell, the objects are ordered by index.
+    std::sort(m_cells.begin(), m_cells.end());
+
+    for(unsigned int start=0;start<m_cells.size();) {
+        unsigned int end = start + 1;
+        while(end < m_cells.size() && m_cells[end].cell == m_cells[start].cell)
+            ++end;
+
+        for(unsigned int a=start;a<end;++a) {
+            const unsigned int i = m_cells[a].object;
+            for(unsigned int b=a+1;b<end;++b) {
+                const unsigned int j = m_cells[b].object;
+                if(boxesOverlap(m_objects[i], m_objects[j]))
+                    pairs.push_back(Pair(i, j));
+            }
+        }
+        start = end;
+    }
+
+    // Objects that share more than one cell produce duplicate pairs
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
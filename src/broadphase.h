@@ -0,0 +1,103 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_BROADPHASE_H
+#define LUOLA_BROADPHASE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Uniform grid broadphase for object-object collisions.
+ *
+ * The grid is rebuilt from scratch every tick: objects are inserted
+ * with add() and the list of potentially colliding pairs is then
+ * generated with findPairs(). The cell size is picked automatically
+ * so that the largest object fits in a 2x2 block of cells. With only
+ * a handful of objects, the bounding boxes of all pairs are tested directly.
+ *
+ * The generated pair list is sorted, so the narrowphase will process
+ * collisions in the same order regardless of where objects are.
+ */
+class Broadphase {
+public:
+    /// A pair of object indices. The first index is always smaller.
+    typedef std::pair<unsigned int, unsigned int> Pair;
+
+    Broadphase();
+
+    /**
+     * Remove all objects from the grid.
+     *
+     * Allocated memory is kept for reuse.
+     */
+    void clear();
+
+    /**
+     * Add an object to the grid.
+     *
+     * Object indices are assigned in insertion order, starting from zero.
+     *
+     * @param pos object center
+     * @param radius object radius
+     */
+    void add(const glm::vec2 &pos, float radius);
+
+    /**
+     * Get the number of objects in the grid.
+     *
+     * @return object count
+     */
+    unsigned int size() const { return m_objects.size(); }
+
+    /**
+     * Find pairs of objects whose bounding boxes share a grid cell.
+     *
+     * The pair list will be cleared first. Each pair is listed only once,
+     * and the list is ordered by the first and then the second index.
+     *
+     * @param pairs the list to which the candidate pairs are written
+     */
+    void findPairs(std::vector<Pair> &pairs);
+
+private:
+    struct Object {
+        glm::vec2 pos;
+        float radius;
+    };
+
+    struct CellEntry {
+        uint64_t cell;
+        unsigned int object;
+
+        bool operator<(const CellEntry &e) const {
+            return cell < e.cell || (cell == e.cell && object < e.object);
+        }
+    };
+
+    static bool boxesOverlap(const Object &a, const Object &b);
+
+    std::vector<Object> m_objects;
+    std::vector<CellEntry> m_cells;
+    float m_maxradius;
+};
+
+#endif
+
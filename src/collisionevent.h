@@ -0,0 +1,62 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_COLLISIONEVENT_H
+#define LUOLA_COLLISIONEVENT_H
+
+#include <glm/glm.hpp>
+
+#include "util/pool.h"
+
+/**
+ * A collision that happened during a simulation step.
+ *
+ * The world collects these into a buffer that is valid until the
+ * next step, so game logic and statistics can react to collisions
+ * without hooking into the physics code.
+ */
+struct CollisionEvent {
+    enum Type {
+        //! Two ships collided
+        SHIP_SHIP,
+        //! A ship hit terrain
+        SHIP_TERRAIN,
+        //! A projectile hit terrain. The projectile has been removed.
+        PROJECTILE_TERRAIN
+    };
+
+    //! Collision type
+    Type type;
+
+    //! Index of the (first) ship
+    unsigned int ship;
+
+    //! Index of the second ship in a ship-ship collision
+    unsigned int other;
+
+    //! Handle of the projectile
+    PoolHandle projectile;
+
+    //! Point of contact
+    glm::vec2 point;
+
+    //! Contact normal, pointing towards the first object
+    glm::vec2 normal;
+};
+
+#endif
+
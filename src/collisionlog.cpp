@@ -0,0 +1,55 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "collisionlog.h"
+
+CollisionLog::CollisionLog(std::ostream &out)
+    : m_out(out), m_tick(0)
+{
+}
+
+void CollisionLog::consume(const std::vector<CollisionEvent> &events)
+{
+    for(const CollisionEvent &e : events) {
+        m_buffer << m_tick << ": ";
+        switch(e.type) {
+            case CollisionEvent::SHIP_SHIP:
+                m_buffer << "ship " << e.ship << " -- ship " << e.other;
+                break;
+            case CollisionEvent::SHIP_TERRAIN:
+                m_buffer << "ship " << e.ship << " -- terrain";
+                break;
+            case CollisionEvent::PROJECTILE_TERRAIN:
+                m_buffer << "projectile " << e.projectile.slot << ":" << e.projectile.generation << " -- terrain";
+                break;
+        }
+        m_buffer << " at (" << e.point.x << ", " << e.point.y << ")"
+            << " [" << e.normal.x << ", " << e.normal.y << "]\n";
+    }
+    ++m_tick;
+}
+
+void CollisionLog::flush()
+{
+    const std::string text = m_buffer.str();
+    if(!text.empty()) {
+        m_out << text;
+        m_out.flush();
+        m_buffer.str(std::string());
+    }
+}
+
@@ -0,0 +1,62 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_COLLISIONLOG_H
+#define LUOLA_COLLISIONLOG_H
+
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+#include "collisionevent.h"
+
+/**
+ * Debug log for collision events.
+ *
+ * Events are formatted into an internal buffer, which is written
+ * out in one go when flushed. This keeps the output stream out of
+ * the simulation loop.
+ */
+class CollisionLog {
+public:
+    /**
+     * Construct a log writing to the given stream.
+     *
+     * @param out output stream. Must outlive the log.
+     */
+    explicit CollisionLog(std::ostream &out);
+
+    /**
+     * Add events to the log.
+     *
+     * @param events the events of one simulation step
+     */
+    void consume(const std::vector<CollisionEvent> &events);
+
+    /**
+     * Write buffered events to the output stream.
+     */
+    void flush();
+
+private:
+    std::ostream &m_out;
+    std::ostringstream m_buffer;
+    unsigned int m_tick;
+};
+
+#endif
+
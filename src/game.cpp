@@ -16,7 +16,11 @@
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <iostream>
+#include <iomanip>
 #include <random>
+#include <chrono>
+#include <algorithm>
+#include <vector>
 #include <cmath>
 
 #include <GL/glew.h>
@@ -37,28 +41,133 @@
 #include "ship/engine.h"
 #include "ship/power.h"
 #include "equipment/equipment.h"
+#include "weapon/weapon.h"
+#include "projectile/projectiledef.h"
+#include "level/levels.h"
+#include "util/conftree.h"
 #include "renderer.h"
+#include "collisionlog.h"
+
+using std::string;
+
+namespace {
+    // Number of headless ticks between collision log flushes
+    const int LOG_FLUSH_TICKS = 60;
+
+    // Projectile used in the renderer stress test
+    const char *STRESS_PROJECTILE = "blastingbolt";
+
+    // Number of frames between frame time reports in the stress test
+    const unsigned int STRESS_REPORT_FRAMES = 600;
+
+    // Keep the world filled with randomly placed projectiles
+    void addStressProjectiles(World &world, int count, std::mt19937 &rng)
+    {
+        const ProjectileDef *def = Projectiles::get(STRESS_PROJECTILE);
+        const terrain::BRect &bounds = world.bounds();
+        std::uniform_real_distribution<float> xpos(bounds.left(), bounds.right());
+        std::uniform_real_distribution<float> ypos(bounds.bottom(), bounds.top());
+        std::uniform_real_distribution<float> vel(-50, 50);
+
+        while(world.projectiles().size() < unsigned(count)) {
+            if(world.addProjectile(Projectile(def,
+                glm::vec2(xpos(rng), ypos(rng)),
+                glm::vec2(vel(rng), vel(rng)))).isNull())
+                break;
+        }
+    }
+
+    // Print frame time percentiles and clear the list
+    void reportFrameTimes(std::vector<double> &times, unsigned int projectiles)
+    {
+        std::sort(times.begin(), times.end());
+        const double p[] = { 0.5, 0.9, 0.99, 1.0 };
+        const char *name[] = { "p50", "p90", "p99", "max" };
+
+        std::cout << "Frame time with " << projectiles << " projectiles (ms):" << std::fixed << std::setprecision(2);
+        for(int i=0;i<4;++i) {
+            const unsigned int j = std::min<unsigned int>(times.size() - 1, p[i] * times.size());
+            std::cout << " " << name[i] << " " << times[j] * 1000.0;
+        }
+        std::cout << "\n";
+        std::cout.unsetf(std::ios::floatfield);
+
+        times.clear();
+    }
+}
+
+bool loadGame(const std::string &gamefile)
+{
+    fs::DataFile df(gamefile);
+
+    // Load resources
+    {
+        resource::Loader rl(df, "resources.yaml");
+    }
+
+    // Load game configuration
+    conftree::Node gameconf = conftree::parseYAML(df, "game.yaml");
+
+    if(!resource::Resources::getInstance().isHeadless()) {
+        string title = gameconf.opt("title", conftree::Node("Luola 2.0")).value();
+        glfwSetWindowTitle(title.c_str());
+    }
+
+    // Models
+    conftree::Node models = gameconf.at("models");
+    Projectiles::setModel(models.at("projectiles").value());
+
+    // Levels
+    conftree::Node levels = gameconf.at("levels");
+    for (int i = 0; i < levels.items(); ++i)
+    {
+        level::LevelRegistry::add(levels.at(i).value());
+    }
+
+    // Load ship components
+    conftree::Node ship = gameconf.at("ship");
+    ShipDefs::loadAll(df, ship.at("hulls").value());
+    Engines::loadAll(df, ship.at("engines").value());
+    PowerPlants::loadAll(df, ship.at("power").value());
+    Equipments::loadAll(df, ship.at("equipment").value());
+    Projectiles::loadAll(df, ship.at("projectiles").value());
+    Weapons::loadAll(df, ship.at("weapons").value());
+
+    return true;
+}
 
-void gameloop(const gameinit::Hotseat &init)
+void gameloop(const gameinit::Hotseat &init, CollisionLog *collisionlog, int projectiles)
 {
     glfwEnable( GLFW_STICKY_KEYS );
     glFrontFace(GL_CW);
 
-    World world;
-    Renderer renderer(world);
+    World world(std::max<unsigned int>(World::MAX_PROJECTILES, std::max(projectiles, 0)));
+    world.setSnapshotsEnabled(true);
 
+    Renderer renderer(world, world.snapshots());
     renderer.setZoom(15);
+    renderer.followPlayer(1);
 
     init.initialize(world);
 
     input::initPlayerInputs();
 
+    std::mt19937 rng(projectiles);
+    std::vector<double> frametimes;
+
     double time_now = glfwGetTime();
     double time_accumulator = 0.0;
 
     do {
         double new_time = glfwGetTime();
         double frame_time = new_time - time_now;
+
+        if(projectiles > 0) {
+            frametimes.push_back(frame_time);
+            if(frametimes.size() >= STRESS_REPORT_FRAMES)
+                reportFrameTimes(frametimes, world.projectiles().size());
+        }
+
         if(frame_time > 0.25)
             frame_time = 0.25;
         time_now = new_time;
@@ -86,16 +195,51 @@ void gameloop(const gameinit::Hotseat &init)
             }
         }
 
+        if(projectiles > 0)
+            addStressProjectiles(world, projectiles, rng);
+
         // Physics
         while(time_accumulator >= Physical::TIMESTEP) {
             world.step();
+            if(collisionlog)
+                collisionlog->consume(world.collisions());
             time_accumulator -= Physical::TIMESTEP;
         }
 
-        // Graphics
-        renderer.setCenter(world.getPlayerShip(1)->physics().position());
-        renderer.render(frame_time);
+        if(collisionlog)
+            collisionlog->flush();
+
+        // Graphics. Objects are drawn partway between the last two
+        // steps, according to how much time is left over.
+        world.updateGl();
+        renderer.render(frame_time, time_accumulator / Physical::TIMESTEP);
     } while( glfwGetKey( GLFW_KEY_ESC ) != GLFW_PRESS && glfwGetWindowParam( GLFW_OPENED ) );
 
     input::deinitPlayerInputs();
 }
+
+void headlessloop(const gameinit::Hotseat &init, int ticks, CollisionLog *collisionlog)
+{
+    World world;
+    init.initialize(world);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    int tick = 0;
+    for(;ticks<=0 || tick<ticks;++tick) {
+        world.step();
+        if(collisionlog) {
+            collisionlog->consume(world.collisions());
+            if(tick % LOG_FLUSH_TICKS == 0)
+                collisionlog->flush();
+        }
+    }
+
+    if(collisionlog)
+        collisionlog->flush();
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Simulated " << tick << " ticks in " << elapsed << " s ("
+        << (tick / elapsed) << " ticks/s, " << (tick / Physical::TPS) << " s of game time)\n";
+}
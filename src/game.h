@@ -18,9 +18,45 @@
 #ifndef LUOLA_GAME_H
 #define LUOLA_GAME_H
 
+#include <string>
+
 namespace gameinit { class Hotseat; }
+class CollisionLog;
+
+/**
+ * Load the game data (resources, ship components, level list.)
+ *
+ * In headless mode, no OpenGL resources are created.
+ *
+ * @param gamefile name of the game data file
+ * @return true on success
+ */
+bool loadGame(const std::string &gamefile);
+
+/**
+ * Run the game with graphics and player input.
+ *
+ * For stress testing the renderer, the world can be kept filled with
+ * the given number of projectiles. They are topped up before every
+ * frame at random positions, and frame time percentiles are printed
+ * every few seconds.
+ *
+ * @param init game initialization parameters
+ * @param collisionlog if not null, collision events are logged here once per frame
+ * @param projectiles number of stress test projectiles to keep in play (0 for none)
+ */
+void gameloop(const gameinit::Hotseat &init, CollisionLog *collisionlog=nullptr, int projectiles=0);
 
-void gameloop(const gameinit::Hotseat &init);
+/**
+ * Run the simulation without graphics, as fast as possible.
+ *
+ * Timing statistics are printed when done.
+ *
+ * @param init game initialization parameters
+ * @param ticks number of ticks to simulate. If zero or less, run forever.
+ * @param collisionlog if not null, collision events are logged here
+ */
+void headlessloop(const gameinit::Hotseat &init, int ticks, CollisionLog *collisionlog=nullptr);
 
 #endif
 
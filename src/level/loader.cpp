@@ -29,6 +29,7 @@ using std::endl;
 #include "../fs/datafile.h"
 #include "../util/tinyxml2.h"
 #include "../terrain/terrains.h"
+#include "../terrain/tiles.h"
 #include "../world.h"
 #include "levels.h"
 #include "exception.h"
@@ -37,6 +38,9 @@ using tinyxml2::XMLElement;
 namespace level {
 
 namespace {
+// Default terrain tile size
+const char *TILE_SIZE = "16";
+
 string Attr(const XMLElement *el, const char *attribute, const char *def)
 {
     const char *val = el->Attribute(attribute);
@@ -90,6 +94,17 @@ std::vector<terrain::ConvexPolygon> parsePolygons(const XMLElement *block)
     return polygons;
 }
 
+// Parse contents of */<block> element and split it into tiles.
+// If tilesize is zero, the block is kept in one piece.
+std::vector<std::vector<terrain::ConvexPolygon>> parseTiles(const XMLElement *block, float tilesize)
+{
+    std::vector<terrain::ConvexPolygon> polygons = parsePolygons(block);
+    if(tilesize > 0)
+        return terrain::splitTiles(polygons, tilesize);
+
+    return std::vector<std::vector<terrain::ConvexPolygon>>(1, polygons);
+}
+
 // Parse <zones>/<block> or <zones>/<root> zone attributes
 terrain::ZoneProps parseZoneProps(const XMLElement *zone)
 {
@@ -123,11 +138,19 @@ void loadRootZone(const XMLElement *root, World &world)
     world.setRootZone(props);
 }
 
-// Parse <zones>/<block> element
-void loadZoneBlock(const XMLElement *zone_el, World &world)
+// Parse <zones>/<block> element. The block is split into tiles like
+// solid terrain, but all the pieces stay in a single zone. A point
+// exactly on a tile seam is inside two pieces, and the zone must
+// still be applied only once.
+void loadZoneBlock(const XMLElement *zone_el, World &world, float tilesize)
 {
     terrain::ZoneProps props = parseZoneProps(zone_el);
-    terrain::Zone *zone = new terrain::Zone(parsePolygons(zone_el));
+
+    std::vector<terrain::ConvexPolygon> polygons;
+    for(const std::vector<terrain::ConvexPolygon> &tile : parseTiles(zone_el, tilesize))
+        polygons.insert(polygons.end(), tile.begin(), tile.end());
+
+    terrain::Zone *zone = new terrain::Zone(polygons);
 
     zone->setZoneForce(props.force);
 
@@ -138,14 +161,14 @@ void loadZoneBlock(const XMLElement *zone_el, World &world)
 }
 
 // Parse <zones> element
-void loadZones(const XMLElement *zones, World &world)
+void loadZones(const XMLElement *zones, World &world, float tilesize)
 {
     const XMLElement *el = zones->FirstChildElement();
     while(el) {
         if(strcmp(el->Name(), "root")==0)
             loadRootZone(el, world);
         else if(strcmp(el->Name(), "block")==0)
-            loadZoneBlock(el, world);
+            loadZoneBlock(el, world, tilesize);
         else {
 #ifndef NDEBUG
             cerr << "Warning: Unknown level zone element: " << el->Name() << endl;
@@ -156,12 +179,13 @@ void loadZones(const XMLElement *zones, World &world)
 }
 
 // Parse <static> element
-void loadStatic(const XMLElement *statics, World &world)
+void loadStatic(const XMLElement *statics, World &world, float tilesize)
 {
     const XMLElement *el = statics->FirstChildElement();
     while(el) {
         if(strcmp(el->Name(), "block")==0) {
-            world.addStaticSolid(new terrain::Solid(parsePolygons(el)));
+            for(const std::vector<terrain::ConvexPolygon> &tile : parseTiles(el, tilesize))
+                world.addStaticSolid(new terrain::Solid(tile));
         } else {
 #ifndef NDEBUG
             cerr << "Warning: Unknown level block element: " << el->Name() << endl;
@@ -171,13 +195,32 @@ void loadStatic(const XMLElement *statics, World &world)
     }
 }
 
-// Parse <solid> element
-void loadSolid(const XMLElement *solids, World &world)
+// Parse the clipper attribute of a <solid> element
+terrain::Clipper parseClipper(const XMLElement *solids)
 {
+    const string clipper = Attr(solids, "clipper", "trace");
+    if(clipper == "trace")
+        return terrain::TRACE_CLIPPER;
+    else if(clipper == "fixed")
+        return terrain::FIXED_CLIPPER;
+
+    throw LevelException("Unknown clipper: " + clipper);
+}
+
+// Parse <solid> element. Each tile of a block becomes a solid of its own,
+// so a hole only affects the tiles it touches.
+void loadSolid(const XMLElement *solids, World &world, float tilesize)
+{
+    const terrain::Clipper clipper = parseClipper(solids);
+
     const XMLElement *el = solids->FirstChildElement();
     while(el) {
         if(strcmp(el->Name(), "block")==0) {
-            world.addSolid(new terrain::Solid(parsePolygons(el)));
+            for(const std::vector<terrain::ConvexPolygon> &tile : parseTiles(el, tilesize)) {
+                terrain::Solid *solid = new terrain::Solid(tile);
+                solid->setClipper(clipper);
+                world.addSolid(solid);
+            }
         } else {
 #ifndef NDEBUG
             cerr << "Warning: Unknown level block element: " << el->Name() << endl;
@@ -187,6 +230,15 @@ void loadSolid(const XMLElement *solids, World &world)
     }
 }
 
+// Parse the tilesize attribute of the <level> element
+float parseTileSize(const XMLElement *root)
+{
+    const float tilesize = atof(Attr(root, "tilesize", TILE_SIZE).c_str());
+    if(!(tilesize >= 0))
+        throw LevelException("tilesize must not be negative!");
+    return tilesize;
+}
+
 void setWorldBounds(const XMLElement *root, World &world)
 {
     string bounds = root->Attribute("bounds");
@@ -224,15 +276,16 @@ void Level::load(World &world) const
     const XMLElement *root = doc.RootElement();
 
     setWorldBounds(root, world);
+    const float tilesize = parseTileSize(root);
 
     const XMLElement *el = root->FirstChildElement();
     while(el) {
         if(strcmp(el->Name(), "zones")==0)
-            loadZones(el, world);
+            loadZones(el, world, tilesize);
         else if(strcmp(el->Name(), "static")==0)
-            loadStatic(el, world);
+            loadStatic(el, world, tilesize);
         else if(strcmp(el->Name(), "solid")==0)
-            loadSolid(el, world);
+            loadSolid(el, world, tilesize);
         else {
 #ifndef NDEBUG
             cerr << "Warning: Unknown level file element: " << el->Name() << endl;
@@ -241,7 +294,8 @@ void Level::load(World &world) const
 
         el = el->NextSiblingElement();
     }
-    
+
+    world.indexZones();
 }
 
 }
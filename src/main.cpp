@@ -24,21 +24,14 @@
 #include <GL/glfw.h>
 
 #include "fs/paths.h"
-#include "fs/datafile.h"
 #include "util/threadpool.h"
-#include "util/conftree.h"
-#include "res/loader.h"
+#include "res/resources.h"
 
 #include "gameinit.h"
-#include "ship/shipdef.h"
-#include "ship/engine.h"
-#include "ship/power.h"
-#include "equipment/equipment.h"
-#include "weapon/weapon.h"
-#include "projectile/projectiledef.h"
 #include "level/levels.h"
 
 #include "game.h"
+#include "collisionlog.h"
 
 using std::string;
 using std::cout;
@@ -54,6 +47,12 @@ namespace {
         string gamefile;
 
         string launchfile;
+
+        bool headless;
+        int ticks;
+
+        bool logcollisions;
+        int projectiles;
     };
 
     Args getCmdlineArgs(int argc, char **argv)
@@ -65,6 +64,10 @@ namespace {
             ("game", po::value<string>(), "game file (default: game.data)")
             ("threads", po::value<int>(), "number of background threads")
             ("launch", po::value<string>(), "quicklaunch file")
+            ("headless", "run the simulation without graphics")
+            ("ticks", po::value<int>(), "number of ticks to run in headless mode (default: unlimited)")
+            ("log-collisions", "print collision events")
+            ("projectiles", po::value<int>(), "renderer stress test: keep this many projectiles in play and print frame times")
             ;
 
         po::variables_map vm;
@@ -94,6 +97,19 @@ namespace {
         if(vm.count("launch"))
             args.launchfile = vm["launch"].as<string>();
 
+        args.headless = vm.count("headless");
+        if(vm.count("ticks"))
+            args.ticks = vm["ticks"].as<int>();
+        else
+            args.ticks = 0;
+
+        args.logcollisions = vm.count("log-collisions");
+
+        if(vm.count("projectiles"))
+            args.projectiles = vm["projectiles"].as<int>();
+        else
+            args.projectiles = 0;
+
         args.width = 800;
         args.height = 600;
 
@@ -136,52 +152,22 @@ namespace {
         glfwSetWindowTitle("Luola 2.0");
         return true;
     }
-
-    bool loadGame(const string &gamefile)
-    {
-        fs::DataFile df(gamefile);
-
-        // Load resources
-        {
-            resource::Loader rl(df, "resources.yaml");
-        }
-
-        // Load game configuration
-        conftree::Node gameconf = conftree::parseYAML(df, "game.yaml");
-
-        string title = gameconf.opt("title", conftree::Node("Luola 2.0")).value();
-        glfwSetWindowTitle(title.c_str());
-
-        // Models
-        conftree::Node models = gameconf.at("models");
-        Projectiles::setModel(models.at("projectiles").value());
-
-        // Levels
-        conftree::Node levels = gameconf.at("levels");
-        for (int i = 0; i < levels.items(); ++i)
-        {
-            level::LevelRegistry::add(levels.at(i).value());
-        }
-
-        // Load ship components
-        conftree::Node ship = gameconf.at("ship");
-        ShipDefs::loadAll(df, ship.at("hulls").value());
-        Engines::loadAll(df, ship.at("engines").value());
-        PowerPlants::loadAll(df, ship.at("power").value());
-        Equipments::loadAll(df, ship.at("equipment").value());
-        Projectiles::loadAll(df, ship.at("projectiles").value());
-        Weapons::loadAll(df, ship.at("weapons").value());
-
-        return true;
-    }
 }
 
 int main(int argc, char **argv) {
 
     // Perform initializations
     gameinit::Hotseat launcher;
+    bool headless;
+    int ticks;
+    bool logcollisions;
+    int projectiles;
     {
         Args args = getCmdlineArgs(argc, argv);
+        headless = args.headless;
+        ticks = args.ticks;
+        logcollisions = args.logcollisions;
+        projectiles = args.projectiles;
 
         if(args.help)
             return 0;
@@ -189,7 +175,9 @@ int main(int argc, char **argv) {
         if(!fs::Paths::init(args.data))
             return 1;
 
-        if(!initOpengl(args.width, args.height))
+        if(args.headless)
+            resource::Resources::getInstance().setHeadless(true);
+        else if(!initOpengl(args.width, args.height))
             return 1;
 
 		level::LevelRegistry::init();
@@ -208,7 +196,13 @@ int main(int argc, char **argv) {
     }
 
     // Run the game
-    gameloop(launcher);
+    CollisionLog collisionlog(cout);
+    CollisionLog *log = logcollisions ? &collisionlog : nullptr;
+
+    if(headless)
+        headlessloop(launcher, ticks, log);
+    else
+        gameloop(launcher, log, projectiles);
  
     return 0;
 }
@@ -15,13 +15,15 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
-#include <iostream>
 
 #include "physics.h"
 #include "world.h"
 
 const float Physical::TPS = 60.0f;
 const float Physical::TIMESTEP = 1.0f / Physical::TPS;
+const int Physical::SLEEP_TICKS = 30;
+const float Physical::SLEEP_SPEED = 0.5f;
+const int Physical::CONTACT_TICKS = 10;
 
 namespace {
     struct Derivate
@@ -64,27 +66,67 @@ namespace {
 }
 
 Physical::Physical()
+    : m_still(0), m_asleep(false), m_contact(CONTACT_TICKS), m_sleepdensity(0)
 {
     setMass(1.0f);
     setRadius(1.0f);
 }
 
 Physical::Physical(float mass, float radius, const glm::vec2 &pos, const glm::vec2 &vel)
-    : m_pos(pos), m_vel(vel)
+    : m_pos(pos), m_vel(vel), m_still(0), m_asleep(false), m_contact(CONTACT_TICKS), m_sleepdensity(0)
 {
     setMass(mass);
     setRadius(radius);
 }
 
-void Physical::step(const World &world)
+Physical::StepResult Physical::step(const World &world, Contact *contact)
+{
+    const terrain::ZoneProps zone = world.zoneAt(m_pos);
+    const glm::vec2 force = zone.gravity + zone.force;
+
+    if(m_asleep) {
+        // A change in the forces acting on the object wakes it up
+        if(force == m_sleepforce && zone.density == m_sleepdensity)
+            return ASLEEP;
+        wake();
+    }
+
+    const glm::vec2 oldpos = m_pos;
+    const bool pushed = m_imp.x != 0 || m_imp.y != 0;
+
+    const StepResult result = move(world, zone, contact);
+
+    if(result == HIT_TERRAIN || result == HIT_BOUNDS)
+        m_contact = 0;
+    else if(m_contact < CONTACT_TICKS)
+        ++m_contact;
+
+    // Objects that have come to rest on terrain are put to sleep until
+    // something disturbs them. Without a recent contact, a slow object
+    // may just be drifting (e.g. in zero gravity or at terminal velocity
+    // in a dense zone) and must keep moving.
+    const float limit = SLEEP_SPEED * SLEEP_SPEED;
+    const glm::vec2 dpos = m_pos - oldpos;
+    if(!pushed && m_contact < CONTACT_TICKS && glm::dot(m_vel, m_vel) < limit && glm::dot(dpos, dpos) < limit * TIMESTEP * TIMESTEP) {
+        if(++m_still >= SLEEP_TICKS) {
+            m_asleep = true;
+            m_vel = glm::vec2(0);
+            m_sleepforce = force;
+            m_sleepdensity = zone.density;
+        }
+    } else {
+        m_still = 0;
+    }
+
+    return result;
+}
+
+Physical::StepResult Physical::move(const World &world, const terrain::ZoneProps &zone, Contact *contact)
 {
     // Apply impulse and reset accumulator
     m_vel += m_imp * imass();
     m_imp = glm::vec2();
 
-    // Get current zone
-    terrain::ZoneProps zone = world.zoneAt(m_pos);
-
     // Integrate forces (RK4)
     Derivate a = evaluate(zone, *this, 0.0f, Derivate());
     Derivate b = evaluate(zone, *this, TIMESTEP*0.5f, a);
@@ -103,35 +145,59 @@ void Physical::step(const World &world)
     glm::vec2 cnorm;
     if(world.checkTerrainCollision(m_pos, m_radius, dpos, cp, cnorm)) {
         // Collision detected!
-        std::cerr << "terrain collision (" << m_pos.x << "," << m_pos.y << ") detected at " << cp.x << ", " << cp.y << " [" << cnorm.x << "," << cnorm.y << "]" << std::endl;
+        if(contact) {
+            contact->point = cp;
+            contact->normal = cnorm;
+        }
         m_pos = cp + cnorm * 0.001f;
         m_vel = glm::vec2(0);
         //m_vel = glm::reflect(m_vel, cnorm);
 
+        return HIT_TERRAIN;
+
     } else {
         // No collisions, apply position step normally.
         m_pos += dposdt * TIMESTEP;
 
         // Make sure the object stays withing the world bounds
+        StepResult result = MOVED;
         if(m_pos.x < world.bounds().left()) {
             m_pos.x = world.bounds().left() + 0.001;
             m_vel.x = 0;
+            result = HIT_BOUNDS;
         } else if(m_pos.x > world.bounds().right()) {
             m_pos.x = world.bounds().right() - 0.001;
             m_vel.x = 0;
+            result = HIT_BOUNDS;
         }
 
         if(m_pos.y < world.bounds().bottom()) {
             m_pos.y = world.bounds().bottom() + 0.001;
             m_vel.y = 0;
+            result = HIT_BOUNDS;
         } else if(m_pos.y > world.bounds().top()) {
             m_pos.y = world.bounds().top() - 0.001;
             m_vel.y = 0;
+            result = HIT_BOUNDS;
         }
+
+        return result;
     }
 }
 
 bool Physical::checkCollision(Physical &other)
+{
+    glm::vec2 impulse;
+    if(!collisionImpulse(other, impulse))
+        return false;
+
+    addImpulse(impulse);
+    other.addImpulse(-impulse);
+
+    return true;
+}
+
+bool Physical::collisionImpulse(const Physical &other, glm::vec2 &impulse) const
 {
     // A collision occurs when distance between
     // the center of this object and other is <= this radius + other radius.
@@ -149,18 +215,17 @@ bool Physical::checkCollision(Physical &other)
     float impact_speed = glm::dot(collv, normal);
 
     // Check if objects are moving away from each other already
-    if(impact_speed  > 0)
+    if(impact_speed  > 0) {
+        impulse = glm::vec2();
         return true;
+    }
 
     // Coefficient of restitution
     const float cor = 0.95f;
 
     // Collision impulse
     float j = -(1.0f + cor) * impact_speed / (imass() + other.imass());
-    glm::vec2 impulse = j * normal;
-
-    addImpulse(impulse);
-    other.addImpulse(-impulse);
+    impulse = j * normal;
 
     return true;
 }
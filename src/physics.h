@@ -21,6 +21,7 @@
 #include <glm/glm.hpp>
 
 class World;
+namespace terrain { struct ZoneProps; }
 
 /**
  * A physical object.
@@ -41,6 +42,46 @@ public:
      */
     static const float TIMESTEP;
 
+    /**
+     * Number of ticks an object must stay still before it falls asleep.
+     */
+    static const int SLEEP_TICKS;
+
+    /**
+     * Speed below which an object is considered to be still.
+     */
+    static const float SLEEP_SPEED;
+
+    /**
+     * Number of ticks after touching terrain during which
+     * an object is considered to be resting on it.
+     */
+    static const int CONTACT_TICKS;
+
+    /**
+     * Outcome of a simulation step
+     */
+    enum StepResult {
+        //! The object moved freely
+        MOVED,
+        //! The object hit terrain and was stopped
+        HIT_TERRAIN,
+        //! The object hit the world boundary and was stopped
+        HIT_BOUNDS,
+        //! The object is asleep and was not simulated
+        ASLEEP
+    };
+
+    /**
+     * A point of contact with terrain
+     */
+    struct Contact {
+        //! Position of the object's center at contact
+        glm::vec2 point;
+        //! Normal of the terrain edge that was hit
+        glm::vec2 normal;
+    };
+
     /**
      * Default constructor
      */
@@ -67,7 +108,7 @@ public:
      *
      * @param pos new position
      */
-    void setPosition(const glm::vec2 pos) { m_pos = pos; }
+    void setPosition(const glm::vec2 pos) { m_pos = pos; wake(); }
 
     /**
      * Get the velocity of the object
@@ -85,16 +126,22 @@ public:
      *
      * @param vel new velocity
      */
-    void setVelocity(const glm::vec2 &vel) { m_vel = vel; }
+    void setVelocity(const glm::vec2 &vel) { m_vel = vel; wake(); }
 
     /**
      * Add an impulse to the impulse accumulator.
      *
      * The total impulse will be applied on the next simulation step.
+     * A nonzero impulse wakes up the object.
      *
      * @param force impulse force
      */
-    void addImpulse(const glm::vec2 &impulse) { m_imp += impulse; }
+    void addImpulse(const glm::vec2 &impulse)
+    {
+        m_imp += impulse;
+        if(impulse.x != 0 || impulse.y != 0)
+            wake();
+    }
 
     /**
      * Get the impulse accumulator
@@ -155,11 +202,35 @@ public:
      */
     float area() const { return m_area; }
 
+    /**
+     * Check if the object is asleep.
+     *
+     * An object that has stayed still for SLEEP_TICKS ticks without
+     * any impulses while resting on terrain (or the world boundary)
+     * falls asleep. An object drifting slowly in free space never falls
+     * asleep. Sleeping objects are not simulated until something
+     * wakes them up, or the zone properties at their position change.
+     *
+     * @return true if asleep
+     */
+    bool isAsleep() const { return m_asleep; }
+
+    /**
+     * Wake up the object.
+     *
+     * This should be called when the object's surroundings change
+     * (e.g. the terrain it is resting on is destroyed.)
+     */
+    void wake() { m_asleep = false; m_still = 0; }
+
     /**
      * Simulate a timestep.
      *
+     * @param world the game state
+     * @param contact if not null, the terrain contact is written here when HIT_TERRAIN is returned
+     * @return what happened to the object during the step
      */
-    void step(const World &world);
+    StepResult step(const World &world, Contact *contact=nullptr);
 
     /**
      * Check if this object is currently colliding with the other object.
@@ -169,7 +240,23 @@ public:
      */
     bool checkCollision(Physical &other);
 
+    /**
+     * Calculate the collision response between this and the other object.
+     *
+     * This is like checkCollision, except the impulse is not applied.
+     * The impulse for this object is returned, the other object
+     * should receive the negation of it.
+     *
+     * @param other the other object to check
+     * @param impulse the collision impulse is written here
+     * @return true if this object is in collision with the other one.
+     */
+    bool collisionImpulse(const Physical &other, glm::vec2 &impulse) const;
+
 private:
+    // Integrate and check for collisions
+    StepResult move(const World &world, const terrain::ZoneProps &zone, Contact *contact);
+
     // Position
     glm::vec2 m_pos;
 
@@ -182,6 +269,17 @@ private:
     float m_mass;
     float m_radius;
     float m_area; // cached
+
+    // Number of ticks the object has been still
+    int m_still;
+    bool m_asleep;
+
+    // Number of ticks since the last terrain contact (up to CONTACT_TICKS)
+    int m_contact;
+
+    // Net zone force and density when the object fell asleep
+    glm::vec2 m_sleepforce;
+    float m_sleepdensity;
 };
 
 #endif
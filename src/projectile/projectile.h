@@ -50,15 +50,19 @@ public:
     const ProjectileDef *def() const { return m_def; }
 
     /**
-     * Draw the projectile
-     * 
-     * @param transform
+     * Get the number of ticks left until the projectile expires.
+     *
+     * A projectile is also spent when it hits terrain or
+     * the world boundary.
+     *
+     * @return remaining lifetime in ticks
      */
-    void draw(const glm::mat4 &transform) const;
+    int ttl() const { return m_ttl; }
 
 private:
     Physical m_physics;
     const ProjectileDef *m_def;
+    int m_ttl;
 
 };
 
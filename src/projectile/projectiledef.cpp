@@ -28,6 +28,7 @@ ProjectileDef::ProjectileDef(const conftree::Node &node)
 
     m_mass = node.at("mass").floatValue();
     m_radius = node.at("radius").floatValue();
+    m_lifetime = node.opt("lifetime").floatValue(10.0f);
     m_mesh = model->mesh()->submeshOffset(node.at("mesh").value());
 }
 
@@ -54,6 +54,16 @@ public:
      */
     float radius() const { return m_radius; }
 
+    /**
+     * The time-to-live of the projectile.
+     *
+     * The projectile is removed from play when this runs out,
+     * even if it hasn't hit anything.
+     *
+     * @return lifetime in seconds
+     */
+    float lifetime() const { return m_lifetime; }
+
     /**
      * Get the submesh of the projectile model to use for rendering
      *
@@ -72,6 +82,7 @@ public:
 private:
     float m_mass;
     float m_radius;
+    float m_lifetime;
 
     resource::MeshSlice m_mesh;
 };
@@ -0,0 +1,374 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cmath>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "projectilestore.h"
+#include "projectile.h"
+#include "../physics.h"
+#include "../world.h"
+#include "../util/threadpool.h"
+
+namespace {
+    // Number of projectiles per parallel task. Must be a multiple of 4
+    const unsigned int STEP_CHUNK = 1024;
+
+    /*
+     * Scalar version of the integrator.
+     *
+     * This performs the same calculations in the same order as
+     * the SIMD version (and Physical::step.)
+     */
+    struct ScalarLane {
+        float gfx, gfy; // gravity + zone force
+        float gbx, gby; // buoyancy
+        float c1; // 0.5 * density
+        float area, imass;
+
+        void acceleration(float vx, float vy, float &ax, float &ay) const
+        {
+            ax = gfx;
+            ay = gfy;
+
+            // Air resistance
+            float v2 = vx*vx + vy*vy;
+            if(v2 > 0.00001f) {
+                float inv = 1.0f / std::sqrt(v2);
+                float t = c1 * v2 * 0.1f * area * imass;
+                ax -= (vx * inv) * t;
+                ay -= (vy * inv) * t;
+            }
+
+            // Buoyancy
+            ax -= gbx;
+            ay -= gby;
+        }
+    };
+
+#ifdef __SSE__
+    // SIMD version of the integrator: four projectiles at a time
+    struct SimdLane {
+        __m128 gfx, gfy;
+        __m128 gbx, gby;
+        __m128 c1;
+        __m128 area, imass;
+
+        void acceleration(__m128 vx, __m128 vy, __m128 &ax, __m128 &ay) const
+        {
+            // Air resistance. Lanes with (nearly) zero velocity are masked out.
+            const __m128 v2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+            const __m128 mask = _mm_cmpgt_ps(v2, _mm_set1_ps(0.00001f));
+            const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v2));
+            const __m128 t = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c1, v2), _mm_set1_ps(0.1f)), area), imass);
+            const __m128 dragx = _mm_and_ps(mask, _mm_mul_ps(_mm_mul_ps(vx, inv), t));
+            const __m128 dragy = _mm_and_ps(mask, _mm_mul_ps(_mm_mul_ps(vy, inv), t));
+
+            // Buoyancy
+            ax = _mm_sub_ps(_mm_sub_ps(gfx, dragx), gbx);
+            ay = _mm_sub_ps(_mm_sub_ps(gfy, dragy), gby);
+        }
+    };
+#endif
+}
+
+ProjectileStore::ProjectileStore(unsigned int capacity)
+    : m_info(capacity),
+      m_posx(capacity), m_posy(capacity),
+      m_velx(capacity), m_vely(capacity),
+      m_impx(capacity), m_impy(capacity),
+      m_imass(capacity),
+      m_radius(capacity),
+      m_area(capacity),
+      m_gx(capacity), m_gy(capacity),
+      m_fx(capacity), m_fy(capacity),
+      m_density(capacity),
+      m_dx(capacity), m_dy(capacity),
+      m_spent(capacity),
+      m_cx(capacity), m_cy(capacity),
+      m_nx(capacity), m_ny(capacity)
+{
+}
+
+PoolHandle ProjectileStore::add(const Projectile &projectile)
+{
+    return add(projectile.def(), projectile.physics(), projectile.ttl());
+}
+
+PoolHandle ProjectileStore::add(const ProjectileDef *def, const Physical &physics, int ttl)
+{
+    Info info = { def, ttl };
+    PoolHandle h = m_info.add(info);
+    if(h.isNull())
+        return h;
+
+    const unsigned int i = m_info.size() - 1;
+    m_posx[i] = physics.position().x;
+    m_posy[i] = physics.position().y;
+    m_velx[i] = physics.velocity().x;
+    m_vely[i] = physics.velocity().y;
+    m_impx[i] = physics.impulse().x;
+    m_impy[i] = physics.impulse().y;
+    m_imass[i] = physics.imass();
+    m_radius[i] = physics.radius();
+    m_area[i] = physics.area();
+
+    return h;
+}
+
+void ProjectileStore::removeAt(unsigned int i)
+{
+    const unsigned int last = m_info.size() - 1;
+    if(i != last) {
+        m_posx[i] = m_posx[last];
+        m_posy[i] = m_posy[last];
+        m_velx[i] = m_velx[last];
+        m_vely[i] = m_vely[last];
+        m_impx[i] = m_impx[last];
+        m_impy[i] = m_impy[last];
+        m_imass[i] = m_imass[last];
+        m_radius[i] = m_radius[last];
+        m_area[i] = m_area[last];
+
+        // The position step is kept for interpolation
+        m_dx[i] = m_dx[last];
+        m_dy[i] = m_dy[last];
+    }
+
+    // The pool moves the last element the same way
+    m_info.removeAt(i);
+}
+
+void ProjectileStore::remove(const PoolHandle &h)
+{
+    int i = indexOf(h);
+    if(i>=0)
+        removeAt(i);
+}
+
+int ProjectileStore::indexOf(const PoolHandle &h) const
+{
+    const Info *info = m_info.get(h);
+    if(!info)
+        return -1;
+    return info - m_info.begin();
+}
+
+void ProjectileStore::addImpulse(unsigned int i, const glm::vec2 &impulse)
+{
+    m_impx[i] += impulse.x;
+    m_impy[i] += impulse.y;
+}
+
+void ProjectileStore::integrate(unsigned int begin, unsigned int end)
+{
+    unsigned int i = begin;
+
+#ifdef __SSE__
+    // Scalar path until we reach an aligned index
+    for(;i<end && i%4;++i)
+        integrateOne(i);
+
+    // SIMD path: four projectiles at a time
+    const float dt = Physical::TIMESTEP;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 sixth = _mm_set1_ps(1.0f/6.0f);
+    const __m128 step = _mm_set1_ps(dt);
+    const __m128 halfstep = _mm_set1_ps(dt*0.5f);
+
+    for(;i+4<=end;i+=4) {
+        // Apply impulse and reset accumulator
+        const __m128 imass = _mm_load_ps(m_imass.data() + i);
+        __m128 vx = _mm_add_ps(_mm_load_ps(m_velx.data() + i), _mm_mul_ps(_mm_load_ps(m_impx.data() + i), imass));
+        __m128 vy = _mm_add_ps(_mm_load_ps(m_vely.data() + i), _mm_mul_ps(_mm_load_ps(m_impy.data() + i), imass));
+        _mm_store_ps(m_impx.data() + i, zero);
+        _mm_store_ps(m_impy.data() + i, zero);
+
+        // Zone dependent constants
+        const __m128 gx = _mm_load_ps(m_gx.data() + i);
+        const __m128 gy = _mm_load_ps(m_gy.data() + i);
+        const __m128 gfx = _mm_add_ps(gx, _mm_load_ps(m_fx.data() + i));
+        const __m128 gfy = _mm_add_ps(gy, _mm_load_ps(m_fy.data() + i));
+        const __m128 density = _mm_load_ps(m_density.data() + i);
+        const __m128 area = _mm_load_ps(m_area.data() + i);
+        const __m128 buoyancy = _mm_mul_ps(_mm_mul_ps(density, area), imass);
+        const SimdLane lane = {
+            gfx, gfy,
+            _mm_mul_ps(gx, buoyancy), _mm_mul_ps(gy, buoyancy),
+            _mm_mul_ps(half, density),
+            area, imass
+        };
+
+        // Integrate forces (RK4)
+        __m128 ax, ay, bx, by, cx, cy, dx, dy;
+        lane.acceleration(vx, vy, ax, ay);
+
+        const __m128 bvx = _mm_add_ps(vx, _mm_mul_ps(ax, halfstep));
+        const __m128 bvy = _mm_add_ps(vy, _mm_mul_ps(ay, halfstep));
+        lane.acceleration(bvx, bvy, bx, by);
+
+        const __m128 cvx = _mm_add_ps(vx, _mm_mul_ps(bx, halfstep));
+        const __m128 cvy = _mm_add_ps(vy, _mm_mul_ps(by, halfstep));
+        lane.acceleration(cvx, cvy, cx, cy);
+
+        const __m128 dvx = _mm_add_ps(vx, _mm_mul_ps(cx, step));
+        const __m128 dvy = _mm_add_ps(vy, _mm_mul_ps(cy, step));
+        lane.acceleration(dvx, dvy, dx, dy);
+
+        const __m128 dposx = _mm_mul_ps(sixth, _mm_add_ps(_mm_add_ps(vx, _mm_mul_ps(two, _mm_add_ps(bvx, cvx))), dvx));
+        const __m128 dposy = _mm_mul_ps(sixth, _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(two, _mm_add_ps(bvy, cvy))), dvy));
+        const __m128 dvelx = _mm_mul_ps(sixth, _mm_add_ps(_mm_add_ps(ax, _mm_mul_ps(two, _mm_add_ps(bx, cx))), dx));
+        const __m128 dvely = _mm_mul_ps(sixth, _mm_add_ps(_mm_add_ps(ay, _mm_mul_ps(two, _mm_add_ps(by, cy))), dy));
+
+        // Position and velocity steps
+        _mm_store_ps(m_dx.data() + i, _mm_mul_ps(dposx, step));
+        _mm_store_ps(m_dy.data() + i, _mm_mul_ps(dposy, step));
+        _mm_store_ps(m_velx.data() + i, _mm_add_ps(vx, _mm_mul_ps(dvelx, step)));
+        _mm_store_ps(m_vely.data() + i, _mm_add_ps(vy, _mm_mul_ps(dvely, step)));
+    }
+#endif
+
+    // Scalar path for the remainder
+    for(;i<end;++i)
+        integrateOne(i);
+}
+
+void ProjectileStore::integrateOne(unsigned int i)
+{
+    const float dt = Physical::TIMESTEP;
+
+    float vx = m_velx[i] + m_impx[i] * m_imass[i];
+    float vy = m_vely[i] + m_impy[i] * m_imass[i];
+    m_impx[i] = 0;
+    m_impy[i] = 0;
+
+    const float buoyancy = m_density[i] * m_area[i] * m_imass[i];
+    const ScalarLane lane = {
+        m_gx[i] + m_fx[i], m_gy[i] + m_fy[i],
+        m_gx[i] * buoyancy, m_gy[i] * buoyancy,
+        0.5f * m_density[i],
+        m_area[i], m_imass[i]
+    };
+
+    float ax, ay, bx, by, cx, cy, dx, dy;
+    lane.acceleration(vx, vy, ax, ay);
+
+    const float bvx = vx + ax * (dt*0.5f);
+    const float bvy = vy + ay * (dt*0.5f);
+    lane.acceleration(bvx, bvy, bx, by);
+
+    const float cvx = vx + bx * (dt*0.5f);
+    const float cvy = vy + by * (dt*0.5f);
+    lane.acceleration(cvx, cvy, cx, cy);
+
+    const float dvx = vx + cx * dt;
+    const float dvy = vy + cy * dt;
+    lane.acceleration(dvx, dvy, dx, dy);
+
+    m_dx[i] = 1.0f/6.0f * (vx + 2.0f*(bvx + cvx) + dvx) * dt;
+    m_dy[i] = 1.0f/6.0f * (vy + 2.0f*(bvy + cvy) + dvy) * dt;
+    m_velx[i] = vx + 1.0f/6.0f * (ax + 2.0f*(bx + cx) + dx) * dt;
+    m_vely[i] = vy + 1.0f/6.0f * (ay + 2.0f*(by + cy) + dy) * dt;
+}
+
+void ProjectileStore::step(const World &world, std::vector<CollisionEvent> &events)
+{
+    const unsigned int count = size();
+
+    // Projectiles are independent of each other, so they can be
+    // moved in parallel. The chunk size is a multiple of the SIMD
+    // width, so every projectile takes the same code path regardless
+    // of how the work is split.
+    ThreadPool::parallelFor(0, count, STEP_CHUNK, [this, &world](unsigned int begin, unsigned int end) {
+        stepRange(world, begin, end);
+    });
+
+    // Report terrain hits while the handles are still valid
+    for(unsigned int i=0;i<count;++i) {
+        if(m_spent[i] == HIT_TERRAIN) {
+            CollisionEvent e;
+            e.type = CollisionEvent::PROJECTILE_TERRAIN;
+            e.ship = 0;
+            e.other = 0;
+            e.projectile = handleAt(i);
+            e.point = glm::vec2(m_cx[i], m_cy[i]);
+            e.normal = glm::vec2(m_nx[i], m_ny[i]);
+            events.push_back(e);
+        }
+    }
+
+    // Remove spent projectiles. Going backwards, the projectile
+    // moved into the freed index has already been checked.
+    for(unsigned int i=count;i>0;--i) {
+        if(m_spent[i-1])
+            removeAt(i-1);
+    }
+}
+
+void ProjectileStore::stepRange(const World &world, unsigned int begin, unsigned int end)
+{
+    // Get current zones
+    for(unsigned int i=begin;i<end;++i) {
+        terrain::ZoneProps zone = world.zoneAt(position(i));
+        m_gx[i] = zone.gravity.x;
+        m_gy[i] = zone.gravity.y;
+        m_fx[i] = zone.force.x;
+        m_fy[i] = zone.force.y;
+        m_density[i] = zone.density;
+    }
+
+    integrate(begin, end);
+
+    // Check for collisions and apply position step.
+    // A projectile is spent as soon as it hits something.
+    const terrain::BRect &bounds = world.bounds();
+    for(unsigned int i=begin;i<end;++i) {
+        Info &info = m_info[i];
+        const glm::vec2 pos = position(i);
+        const glm::vec2 dpos(m_dx[i], m_dy[i]);
+
+        if(--info.ttl < 0) {
+            m_spent[i] = EXPIRED;
+            continue;
+        }
+
+        terrain::Point cp;
+        glm::vec2 cnorm;
+        if(world.checkTerrainCollision(pos, m_radius[i], dpos, cp, cnorm)) {
+            const glm::vec2 contact = cp - cnorm * m_radius[i];
+            m_cx[i] = contact.x;
+            m_cy[i] = contact.y;
+            m_nx[i] = cnorm.x;
+            m_ny[i] = cnorm.y;
+            m_spent[i] = HIT_TERRAIN;
+            continue;
+        }
+
+        const glm::vec2 newpos = pos + dpos;
+        m_posx[i] = newpos.x;
+        m_posy[i] = newpos.y;
+        const bool outside =
+            newpos.x < bounds.left() || newpos.x > bounds.right() ||
+            newpos.y < bounds.bottom() || newpos.y > bounds.top();
+        m_spent[i] = outside ? EXPIRED : ALIVE;
+    }
+}
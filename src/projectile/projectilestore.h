@@ -0,0 +1,195 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_PROJECTILE_STORE_H
+#define LUOLA_PROJECTILE_STORE_H
+
+#include <glm/glm.hpp>
+
+#include "../util/pool.h"
+#include "../util/alignedarray.h"
+#include "../collisionevent.h"
+
+class World;
+class Physical;
+class Projectile;
+class ProjectileDef;
+
+/**
+ * Storage for all the projectiles in play.
+ *
+ * The physical state of the projectiles is kept in a structure-of-arrays
+ * layout, so all projectiles can be integrated in one batch using SIMD
+ * instructions. The integrator produces the same results as Physical::step
+ * (within floating point rounding.)
+ *
+ * Like in a Pool, removal moves the last projectile into the freed index
+ * and projectiles are referred to by generational handles.
+ */
+class ProjectileStore {
+public:
+    /**
+     * Construct an empty store.
+     *
+     * @param capacity maximum number of projectiles
+     */
+    explicit ProjectileStore(unsigned int capacity);
+
+    /**
+     * Add a projectile.
+     *
+     * @param projectile the projectile to add
+     * @return projectile handle or a null handle if the store is full
+     */
+    PoolHandle add(const Projectile &projectile);
+
+    /**
+     * Add a projectile.
+     *
+     * @param def projectile definition
+     * @param physics initial physical state
+     * @param ttl lifetime in ticks
+     * @return projectile handle or a null handle if the store is full
+     */
+    PoolHandle add(const ProjectileDef *def, const Physical &physics, int ttl);
+
+    /**
+     * Remove the projectile at the given index.
+     *
+     * @param i projectile index
+     */
+    void removeAt(unsigned int i);
+
+    /**
+     * Remove the projectile the handle points to.
+     *
+     * @param h projectile handle
+     */
+    void remove(const PoolHandle &h);
+
+    /**
+     * Get the index of the projectile the handle points to.
+     *
+     * @param h projectile handle
+     * @return projectile index or -1 if the projectile no longer exists
+     */
+    int indexOf(const PoolHandle &h) const;
+
+    /**
+     * Get the number of projectiles in play.
+     *
+     * @return projectile count
+     */
+    unsigned int size() const { return m_info.size(); }
+
+    /**
+     * Get the maximum number of projectiles.
+     *
+     * @return capacity
+     */
+    unsigned int capacity() const { return m_info.capacity(); }
+
+    //// Per projectile properties
+
+    PoolHandle handleAt(unsigned int i) const { return m_info.handleAt(i); }
+    const ProjectileDef *def(unsigned int i) const { return m_info[i].def; }
+    int ttl(unsigned int i) const { return m_info[i].ttl; }
+    glm::vec2 position(unsigned int i) const { return glm::vec2(m_posx[i], m_posy[i]); }
+    glm::vec2 velocity(unsigned int i) const { return glm::vec2(m_velx[i], m_vely[i]); }
+    float radius(unsigned int i) const { return m_radius[i]; }
+
+    /**
+     * Get the distance the projectile moved during the last step.
+     *
+     * Only valid for projectiles that have been stepped at least once.
+     *
+     * @param i projectile index
+     * @return position change
+     */
+    glm::vec2 displacement(unsigned int i) const { return glm::vec2(m_dx[i], m_dy[i]); }
+
+    /**
+     * Add an impulse to the projectile's impulse accumulator.
+     *
+     * @param i projectile index
+     * @param impulse impulse force
+     */
+    void addImpulse(unsigned int i, const glm::vec2 &impulse);
+
+    /**
+     * Simulate a timestep.
+     *
+     * Spent projectiles (expired or hit something) are removed.
+     * The projectiles are moved in parallel on the thread pool.
+     *
+     * @param world the game state
+     * @param events terrain collisions are appended here in projectile index order
+     */
+    void step(const World &world, std::vector<CollisionEvent> &events);
+
+    /**
+     * Integrate the motion of projectiles in range [begin, end[.
+     *
+     * The zone property columns must be filled in first.
+     * Velocities are updated and the position step is written into
+     * the displacement columns, but positions are not changed.
+     *
+     * @param begin first projectile index
+     * @param end last projectile index + 1
+     */
+    void integrate(unsigned int begin, unsigned int end);
+
+private:
+    struct Info {
+        const ProjectileDef *def;
+        int ttl;
+    };
+
+    // Values of the spent column
+    enum Spent {
+        ALIVE = 0,
+        EXPIRED,
+        HIT_TERRAIN
+    };
+
+    void integrateOne(unsigned int i);
+    void stepRange(const World &world, unsigned int begin, unsigned int end);
+
+    Pool<Info> m_info;
+
+    // Physical state
+    AlignedArray<float> m_posx, m_posy;
+    AlignedArray<float> m_velx, m_vely;
+    AlignedArray<float> m_impx, m_impy;
+    AlignedArray<float> m_imass;
+    AlignedArray<float> m_radius;
+    AlignedArray<float> m_area;
+
+    // Per tick scratch space: zone properties and position step
+    AlignedArray<float> m_gx, m_gy;
+    AlignedArray<float> m_fx, m_fy;
+    AlignedArray<float> m_density;
+    AlignedArray<float> m_dx, m_dy;
+    AlignedArray<unsigned char> m_spent;
+
+    // Terrain contact point and normal of projectiles that hit terrain
+    AlignedArray<float> m_cx, m_cy;
+    AlignedArray<float> m_nx, m_ny;
+};
+
+#endif
+
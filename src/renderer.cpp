@@ -15,6 +15,8 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <cmath>
+
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "world.h"
@@ -22,11 +24,28 @@
 #include "res/font.h"
 #include "res/model.h"
 
-#include "ship/ship.h"
 #include "projectile/projectiledef.h"
 
-Renderer::Renderer(const World &world)
-    : m_world(world)
+namespace {
+    // Terrain fill colors
+    const glm::vec4 STATIC_TERRAIN_COLOR(0.45f, 0.45f, 0.5f, 1.0f);
+    const glm::vec4 DYNAMIC_TERRAIN_COLOR(0.6f, 0.45f, 0.3f, 1.0f);
+    const glm::vec4 ZONE_COLOR(0.2f, 0.4f, 0.9f, 0.3f);
+
+    // Interpolate between two angles along the shorter arc
+    float mixAngle(float a, float b, float alpha)
+    {
+        float d = b - a;
+        if(d > M_PI)
+            d -= 2 * M_PI;
+        else if(d < -M_PI)
+            d += 2 * M_PI;
+        return a + d * alpha;
+    }
+}
+
+Renderer::Renderer(const World &world, TripleBuffer<RenderSnapshot> &snapshots)
+    : m_world(world), m_snapshots(snapshots), m_follow(0)
 {
     m_font = resource::get<resource::Font>("core.font.default");
 }
@@ -49,32 +68,169 @@ void Renderer::updateProjection()
     glm::mat4 proj = glm::ortho(-m_zoom, m_zoom, -m_zoom, m_zoom);
     // TODO prevent viewport from going outside world bounds
     m_projection = glm::translate(proj, -glm::vec3(m_center, 0));
+    m_view = terrain::BRect(m_center - glm::vec2(m_zoom), m_center + glm::vec2(m_zoom));
+}
+
+bool Renderer::isVisible(const terrain::BRect &bounds)
+{
+    if(bounds.overlaps(m_view)) {
+        ++m_culling.drawn;
+        return true;
+    }
+    ++m_culling.culled;
+    return false;
+}
+
+void Renderer::addTerrain(const terrain::Terrain &t)
+{
+    // Destroyed terrain has nothing to draw and no bounds
+    if(!t.isEmpty() && isVisible(t.bounds()))
+        m_terrainranges.insert(m_terrainranges.end(), t.indexRanges().begin(), t.indexRanges().end());
 }
 
-void Renderer::render(double frametime) const
+void Renderer::render(double frametime, float alpha)
 {
+    static const glm::vec3 axis(0, 0, 1);
+
+    m_snapshots.update();
+    const RenderSnapshot &snapshot = m_snapshots.readBuffer();
+
+    if(m_follow) {
+        for(const RenderSnapshot::Ship &ship : snapshot.ships) {
+            if(ship.player == m_follow) {
+                setCenter(glm::mix(ship.prevpos, ship.pos, alpha));
+                break;
+            }
+        }
+    }
+
     glClear( GL_COLOR_BUFFER_BIT );
 
-    for(const terrain::Zone *zone : m_world.m_zones)
-        zone->draw(m_projection);
+    m_culling = Culling();
 
+    // The visible blocks of each terrain buffer are drawn with a single call
+    m_terrainranges.clear();
     for(const terrain::Solid *solid : m_world.m_static_terrain)
-        solid->draw(m_projection);
+        addTerrain(*solid);
+    m_world.m_staticbuffer.draw(m_queue, RenderQueue::TERRAIN_LAYER, m_projection, STATIC_TERRAIN_COLOR, false, m_terrainranges);
 
+    m_terrainranges.clear();
     for(const terrain::Solid *solid : m_world.m_dyn_terrain)
-        solid->draw(m_projection);
+        addTerrain(*solid);
+    m_world.m_dynbuffer.draw(m_queue, RenderQueue::TERRAIN_LAYER, m_projection, DYNAMIC_TERRAIN_COLOR, false, m_terrainranges);
+
+    m_terrainranges.clear();
+    for(const terrain::Zone *zone : m_world.m_zones)
+        addTerrain(*zone);
+    m_world.m_zonebuffer.draw(m_queue, RenderQueue::ZONE_LAYER, m_projection, ZONE_COLOR, true, m_terrainranges);
+
+    for(const RenderSnapshot::Ship &ship : snapshot.ships) {
+        const glm::vec2 pos = glm::mix(ship.prevpos, ship.pos, alpha);
+        if(!isVisible(terrain::sweptCircleBounds(pos, ship.radius, glm::vec2())))
+            continue;
+
+        glm::mat4 m = glm::rotate(
+            glm::translate(
+                m_projection,
+                glm::vec3(pos, 0.0f)),
+            glm::degrees(mixAngle(ship.prevangle, ship.angle, alpha)) - 90,
+            axis);
+
+        ship.model->draw(m_queue, RenderQueue::SHIP_LAYER, m);
+    }
 
-    for(const Ship &ship : m_world.m_ships)
-        ship.draw(m_projection);
+    if(Projectiles::getModel()->isInstanced())
+        renderProjectilesInstanced(snapshot, alpha);
+    else
+        renderProjectiles(snapshot, alpha);
 
-    Projectiles::getModel()->prepareRender();
-    for(const Projectile &p : m_world.m_projectiles)
-        p.draw(m_projection);
-    Projectiles::getModel()->endRender();
+    m_queue.flush();
 
     m_font->text("FPS: %.1f", 1.0 / frametime)
     .scale(0.5).pos(1,1).align(resource::TextRenderer::RIGHT).color(1,1,0)
     .render();
 
+    // Render queue and culling statistics of this frame
+    const RenderQueue::Stats &stats = m_queue.stats();
+    m_font->text("Draws: %u  Programs: %u  VAOs: %u  Textures: %u  MVPs: %u",
+        stats.items, stats.programs, stats.vaos, stats.textures, stats.uniforms)
+    .scale(0.35).pos(1,0.88).align(resource::TextRenderer::RIGHT).color(1,1,0)
+    .render();
+
+    m_font->text("Drawn: %u  Culled: %u", m_culling.drawn, m_culling.culled)
+    .scale(0.35).pos(1,0.80).align(resource::TextRenderer::RIGHT).color(1,1,0)
+    .render();
+
     glfwSwapBuffers();
 }
+
+void Renderer::renderProjectiles(const RenderSnapshot &snapshot, float alpha)
+{
+    const resource::Model *pmodel = Projectiles::getModel();
+    for(const RenderSnapshot::Projectile &p : snapshot.projectiles) {
+        const glm::vec2 pos = glm::mix(p.prevpos, p.pos, alpha);
+        if(!isVisible(terrain::sweptCircleBounds(pos, p.radius, glm::vec2())))
+            continue;
+
+        glm::mat4 m = glm::scale(
+            glm::translate(m_projection, glm::vec3(pos, 0.0f)),
+            glm::vec3(p.radius));
+
+        pmodel->draw(m_queue, RenderQueue::PROJECTILE_LAYER, m, p.mesh.first, p.mesh.second);
+    }
+}
+
+void Renderer::renderProjectilesInstanced(const RenderSnapshot &snapshot, float alpha)
+{
+    if(snapshot.projectiles.empty())
+        return;
+
+    // Count the visible projectiles using each mesh slice. There are only
+    // a few different kinds of projectiles, so a linear search will do.
+    m_batchof.resize(snapshot.projectiles.size());
+    m_batches.clear();
+    unsigned int visible = 0;
+    for(unsigned int i=0;i<snapshot.projectiles.size();++i) {
+        const RenderSnapshot::Projectile &p = snapshot.projectiles[i];
+        if(!isVisible(terrain::sweptCircleBounds(glm::mix(p.prevpos, p.pos, alpha), p.radius, glm::vec2()))) {
+            m_batchof[i] = -1;
+            continue;
+        }
+
+        const resource::MeshSlice &mesh = p.mesh;
+        unsigned int b = 0;
+        while(b<m_batches.size() && m_batches[b].mesh != mesh)
+            ++b;
+        if(b == m_batches.size())
+            m_batches.push_back(InstanceBatch { mesh, 0, 0 });
+        ++m_batches[b].count;
+        m_batchof[i] = b;
+        ++visible;
+    }
+
+    if(visible == 0)
+        return;
+
+    GLint first = 0;
+    for(InstanceBatch &batch : m_batches) {
+        batch.first = first;
+        first += batch.count;
+        batch.count = 0;
+    }
+
+    // Instance data: interpolated position and scale
+    m_instances.resize(visible);
+    for(unsigned int i=0;i<snapshot.projectiles.size();++i) {
+        if(m_batchof[i] < 0)
+            continue;
+
+        const RenderSnapshot::Projectile &p = snapshot.projectiles[i];
+        InstanceBatch &batch = m_batches[m_batchof[i]];
+        m_instances[batch.first + batch.count++] = glm::vec4(glm::mix(p.prevpos, p.pos, alpha), p.radius, 0.0f);
+    }
+
+    const resource::Model *pmodel = Projectiles::getModel();
+    pmodel->setInstances(m_instances);
+    for(const InstanceBatch &batch : m_batches)
+        pmodel->drawInstances(m_queue, RenderQueue::PROJECTILE_LAYER, m_projection, batch.mesh.first, batch.mesh.second, batch.first, batch.count);
+}
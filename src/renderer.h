@@ -18,15 +18,38 @@
 #ifndef LUOLA_RENDERER_H
 #define LUOLA_RENDERER_H
 
+#include <vector>
 #include <glm/glm.hpp>
-#include "terrain/common.h"
+#include "terrain/bounds.h"
+#include "terrain/terrainbuffer.h"
+#include "rendersnapshot.h"
+#include "renderqueue.h"
+#include "util/triplebuffer.h"
 
 class World;
 namespace resource { class Font; }
+namespace terrain { class Terrain; }
 
 class Renderer {
 public:
-    Renderer(const World &world);
+    //! Number of objects drawn and skipped in a frame
+    struct Culling {
+        Culling() : drawn(0), culled(0) { }
+
+        unsigned int drawn;
+        unsigned int culled;
+    };
+
+    /**
+     * Construct a renderer.
+     *
+     * Terrain is drawn directly from the world, game objects from
+     * the render snapshots the world publishes.
+     *
+     * @param world the world whose terrain to draw
+     * @param snapshots the snapshot buffer to consume
+     */
+    Renderer(const World &world, TripleBuffer<RenderSnapshot> &snapshots);
 
     /**
      * Center the given point in the viewport.
@@ -38,6 +61,13 @@ public:
      */
     void setCenter(const terrain::Point &point);
 
+    /**
+     * Keep the given player's ship centered in the viewport.
+     *
+     * @param player player number or 0 to stop following
+     */
+    void followPlayer(int player) { m_follow = player; }
+
     /**
      * Set the zoom factor.
      *
@@ -47,18 +77,79 @@ public:
      */
     void setZoom(float zoom);
 
-    void render(double frametime) const;
+    /**
+     * Render a frame.
+     *
+     * Game objects are drawn at a position interpolated between the
+     * last two simulation steps. The frame rate, stats() and culling()
+     * are shown in the top right corner.
+     *
+     * @param frametime length of the last frame
+     * @param alpha interpolation factor in range [0..1]
+     */
+    void render(double frametime, float alpha);
+
+    /**
+     * Get the draw call and state change counts of the last frame.
+     *
+     * Text is not included.
+     *
+     * @return render queue statistics
+     */
+    const RenderQueue::Stats &stats() const { return m_queue.stats(); }
+
+    /**
+     * Get the number of objects drawn and culled in the last frame.
+     *
+     * Objects (terrain blocks, ships and projectiles) whose bounds are
+     * completely outside the view are not drawn.
+     *
+     * @return culling counts
+     */
+    const Culling &culling() const { return m_culling; }
 
 private:
     void updateProjection();
 
+    // Check if a bounding box is in view and count the result
+    bool isVisible(const terrain::BRect &bounds);
+
+    // Collect the index ranges of a terrain block if it is in view
+    void addTerrain(const terrain::Terrain &t);
+
+    // Queue projectiles with one draw call per mesh slice
+    void renderProjectilesInstanced(const RenderSnapshot &snapshot, float alpha);
+
+    // Queue projectiles one at a time
+    void renderProjectiles(const RenderSnapshot &snapshot, float alpha);
+
     const World &m_world;
+    TripleBuffer<RenderSnapshot> &m_snapshots;
+    int m_follow;
 
     terrain::Point m_center;
     float m_zoom;
     glm::mat4 m_projection;
+    terrain::BRect m_view;
+    Culling m_culling;
 
     resource::Font *m_font;
+
+    RenderQueue m_queue;
+
+    // Index ranges of the visible terrain blocks in a terrain buffer
+    std::vector<terrain::TerrainBuffer::Range> m_terrainranges;
+
+    // Projectile instances grouped by mesh slice, and the batch
+    // of each projectile (-1 if not visible)
+    struct InstanceBatch {
+        resource::MeshSlice mesh;
+        GLint first;
+        GLsizei count;
+    };
+    std::vector<InstanceBatch> m_batches;
+    std::vector<int> m_batchof;
+    std::vector<glm::vec4> m_instances;
 };
 
 #endif
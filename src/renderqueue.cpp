@@ -0,0 +1,114 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "renderqueue.h"
+#include "res/texture.h"
+
+void RenderQueue::flush()
+{
+    // Sort by state. The item index breaks ties, so the order
+    // of otherwise equal items is preserved.
+    m_order.resize(m_items.size());
+    for(unsigned int i=0;i<m_order.size();++i)
+        m_order[i] = i;
+
+    std::sort(m_order.begin(), m_order.end(), [this](unsigned int a, unsigned int b) {
+        const Item &ia = m_items[a];
+        const Item &ib = m_items[b];
+        if(ia.layer != ib.layer)
+            return ia.layer < ib.layer;
+        if(ia.program != ib.program)
+            return ia.program < ib.program;
+        if(ia.vao != ib.vao)
+            return ia.vao < ib.vao;
+        if(ia.textures != ib.textures)
+            return ia.textures < ib.textures;
+        return a < b;
+    });
+
+    m_stats = Stats();
+    m_stats.items = m_items.size();
+
+    GLuint program = 0, vao = 0;
+    const resource::Model::UniformTextures *textures = nullptr;
+    bool blend = false;
+    bool mvpset = false;
+    glm::mat4 mvp;
+
+    for(unsigned int i=0;i<m_order.size();++i) {
+        const Item &item = m_items[m_order[i]];
+        const bool first = i == 0;
+
+        // Texture sampler uniforms belong to the program, so the
+        // textures are set again whenever the program changes
+        if(first || item.program != program) {
+            glUseProgram(item.program);
+            program = item.program;
+            textures = nullptr;
+            mvpset = false;
+            ++m_stats.programs;
+        }
+
+        if(first || item.vao != vao) {
+            glBindVertexArray(item.vao);
+            vao = item.vao;
+            ++m_stats.vaos;
+        }
+
+        if(item.textures && item.textures != textures) {
+            int texi = 0;
+            for(const resource::Model::UniformTexture &t : *item.textures) {
+                glActiveTexture(GL_TEXTURE0 + texi);
+                glBindTexture(t.second->target(), t.second->id());
+                glUniform1i(t.first, texi);
+                ++texi;
+            }
+            textures = item.textures;
+            ++m_stats.textures;
+        }
+
+        if(first || item.blend != blend) {
+            if(item.blend) {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            } else {
+                glDisable(GL_BLEND);
+            }
+            blend = item.blend;
+        }
+
+        if(!mvpset || item.mvp != mvp) {
+            glUniformMatrix4fv(item.mvpuniform, 1, GL_FALSE, &item.mvp[0][0]);
+            mvp = item.mvp;
+            mvpset = true;
+            ++m_stats.uniforms;
+        }
+
+        item.draw();
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+
+    m_items.clear();
+}
+
@@ -0,0 +1,119 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_RENDERQUEUE_H
+#define LUOLA_RENDERQUEUE_H
+
+#include <functional>
+#include <vector>
+
+#include <GL/glfw.h>
+#include <glm/glm.hpp>
+
+#include "res/model.h"
+
+/**
+ * A queue of draw calls sorted to minimize state changes.
+ *
+ * Draw items can be submitted in any order. When the queue is flushed,
+ * the items are sorted by layer, shader program, vertex array and
+ * texture set, and drawn in that order. Binds that would not change
+ * anything are skipped, as are MVP uploads when consecutive items of
+ * the same program use the same matrix.
+ *
+ * Layers are drawn in ascending order, so they determine what is drawn
+ * on top of what. Items with the same layer and state are drawn in
+ * the order they were submitted.
+ */
+class RenderQueue {
+public:
+    enum Layer {
+        TERRAIN_LAYER,
+        ZONE_LAYER,
+        SHIP_LAYER,
+        PROJECTILE_LAYER
+    };
+
+    //! Issue the actual draw call. The item's state has been set up already.
+    typedef std::function<void()> DrawFunction;
+
+    struct Item {
+        //! Stacking order (see Layer)
+        int layer;
+
+        //! Shader program
+        GLuint program;
+
+        //! Vertex array object
+        GLuint vao;
+
+        //! Textures to bind (may be null)
+        const resource::Model::UniformTextures *textures;
+
+        //! Enable alpha blending
+        bool blend;
+
+        //! Location of the MVP uniform
+        GLint mvpuniform;
+
+        //! The MVP matrix
+        glm::mat4 mvp;
+
+        DrawFunction draw;
+    };
+
+    //! Number of draw items and state changes in a frame
+    struct Stats {
+        Stats() : items(0), programs(0), vaos(0), textures(0), uniforms(0) { }
+
+        unsigned int items;
+        unsigned int programs;
+        unsigned int vaos;
+        unsigned int textures;
+        unsigned int uniforms;
+    };
+
+    /**
+     * Add an item to the queue.
+     *
+     * @param item the draw item
+     */
+    void submit(Item &&item) { m_items.push_back(std::move(item)); }
+
+    /**
+     * Draw all queued items and empty the queue.
+     *
+     * The OpenGL state is reset afterwards: no program or vertex array
+     * is bound and blending is disabled.
+     */
+    void flush();
+
+    /**
+     * Get the statistics of the last flush.
+     *
+     * @return draw item and bind counts
+     */
+    const Stats &stats() const { return m_stats; }
+
+private:
+    std::vector<Item> m_items;
+    std::vector<unsigned int> m_order;
+    Stats m_stats;
+};
+
+#endif
+
@@ -0,0 +1,77 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_RENDERSNAPSHOT_H
+#define LUOLA_RENDERSNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "res/mesh.h"
+
+namespace resource { class Model; }
+
+/**
+ * The state of the game objects needed for drawing a frame.
+ *
+ * The world publishes one of these at the end of each simulation step.
+ * Each object's state is included both as it was at the start and at the
+ * end of the step, so the renderer can interpolate between the last two
+ * ticks even if it missed some snapshots in between.
+ */
+struct RenderSnapshot {
+    struct Ship {
+        //! The player who owns the ship
+        int player;
+
+        //! Position at the start and the end of the step
+        glm::vec2 prevpos, pos;
+
+        //! Angle at the start and the end of the step
+        float prevangle, angle;
+
+        //! Ship radius
+        float radius;
+
+        //! Ship model
+        const resource::Model *model;
+    };
+
+    struct Projectile {
+        //! Position at the start and the end of the step
+        glm::vec2 prevpos, pos;
+
+        //! Projectile radius
+        float radius;
+
+        //! Submesh of the projectile model
+        resource::MeshSlice mesh;
+    };
+
+    RenderSnapshot() : tick(0) { }
+
+    //! Number of steps simulated when the snapshot was taken
+    uint64_t tick;
+
+    std::vector<Ship> ships;
+    std::vector<Projectile> projectiles;
+};
+
+#endif
+
@@ -18,6 +18,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <cstdarg>
 
@@ -25,6 +26,7 @@
 
 #include "../util/tinyxml2.h"
 #include "../fs/datafile.h"
+#include "../util/rangeallocator.h"
 
 #include "font.h"
 #include "texture.h"
@@ -119,12 +121,10 @@ namespace {
 class FontImpl {
 public:
     FontImpl(const CharMap &charmap, Texture *texture, Program *program)
-        : m_charmap(charmap)
+        : m_charmap(charmap), m_allocator(INITIAL_VERTICES), m_clock(0)
     {
-        // Create vertices and their UV coordinates.
-        std::vector<glm::vec2> vertex;
-        std::vector<glm::vec2> uv;
-
+        // Create the glyph quads. These are copied into the layout
+        // of each string.
         const glm::vec2 scale(1.0f / texture->width(), 1.0f / texture->height());
 
         int ind = 0;
@@ -139,18 +139,20 @@ public:
 
             c.second.width *= scale.x;
 
-            // Vertices
-            vertex.push_back(glm::vec2(x0, -y0));
-            vertex.push_back(glm::vec2(x0 + w, -y0));
-            vertex.push_back(glm::vec2(x0 + w, -y0 - h));
-            vertex.push_back(glm::vec2(x0, -y0 - h));
-
-            // Texture coordinates
-            uv.push_back(glm::vec2(c.second.left, c.second.top) * scale);
-            uv.push_back(glm::vec2(c.second.right, c.second.top) * scale);
-            uv.push_back(glm::vec2(c.second.right, c.second.bottom) * scale);
-            uv.push_back(glm::vec2(c.second.left, c.second.bottom) * scale);
+            // Vertices and texture coordinates
+            m_glyphs.push_back(Vertex { glm::vec2(x0, -y0), glm::vec2(c.second.left, c.second.top) * scale });
+            m_glyphs.push_back(Vertex { glm::vec2(x0 + w, -y0), glm::vec2(c.second.right, c.second.top) * scale });
+            m_glyphs.push_back(Vertex { glm::vec2(x0 + w, -y0 - h), glm::vec2(c.second.right, c.second.bottom) * scale });
+            m_glyphs.push_back(Vertex { glm::vec2(x0, -y0 - h), glm::vec2(c.second.left, c.second.bottom) * scale });
+        }
 
+        if(Resources::getInstance().isHeadless()) {
+            m_vao = 0;
+            m_buffer = 0;
+            m_program_id = 0;
+            m_texture_id = 0;
+            m_texture_uniform = m_offset_uniform = m_color_uniform = m_scale_uniform = 0;
+            return;
         }
 
         // Create the vertex array object for the font
@@ -163,42 +165,23 @@ public:
         m_color_uniform = glGetUniformLocation(program->id(), "color");
         m_scale_uniform = glGetUniformLocation(program->id(), "scale");
 
-        glGenBuffers(3, m_buffers);
-
-        // Bind vertex buffer (0)
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
+        // The layouts of recently drawn strings are kept in this buffer.
+        // Vertices (0) and UV coordinates (1) are interleaved.
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
         glBufferData(
             GL_ARRAY_BUFFER,
-            sizeof(glm::vec2) * vertex.size(),
-            vertex.data(),
-            GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+            sizeof(Vertex) * m_allocator.size(),
+            nullptr,
+            GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
 
-        // Bind UV buffer (1)
         glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[1]);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            sizeof(glm::vec2) * uv.size(),
-            uv.data(),
-            GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(sizeof(glm::vec2)));
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Bind element index buffer
-        // Only two triangles are need to draw each glyph.
-        // They can be represented simply as a triangle strip.
-        static const GLushort elements[] = { 0, 1, 3, 2 };
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[2]);
-        glBufferData(
-            GL_ELEMENT_ARRAY_BUFFER,
-            sizeof(elements),
-            elements,
-            GL_STATIC_DRAW);
-
         glBindVertexArray(0);
 
         m_program_id = program->id();
@@ -207,12 +190,14 @@ public:
 
     ~FontImpl()
     {
-        glDeleteBuffers(3, m_buffers);
-        glDeleteVertexArrays(1, &m_vao);
+        if(m_vao) {
+            glDeleteBuffers(1, &m_buffer);
+            glDeleteVertexArrays(1, &m_vao);
+        }
     }
 
     void renderText(
-        const char *text,
+        const string &text,
         float scale,
         glm::vec2 pos,
         const glm::vec4 &color,
@@ -220,6 +205,12 @@ public:
     {
         glBindVertexArray(m_vao);
 
+        const Layout &l = layout(text);
+        if(l.count == 0) {
+            glBindVertexArray(0);
+            return;
+        }
+
         glUseProgram(m_program_id);
 
         glActiveTexture(GL_TEXTURE0);
@@ -229,38 +220,129 @@ public:
         glUniform4fv(m_color_uniform, 1, &color[0]);
         glUniform1f(m_scale_uniform, scale);
 
+        if(align == TextRenderer::RIGHT)
+            pos.x -= l.width * scale;
+
+        glUniform2fv(m_offset_uniform, 1, &pos[0]);
+
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        if(align == TextRenderer::RIGHT) {
-            float xoff = 0;
-            const char *s = text;
-            while(*s) {
-                const CharDescription &chr = m_charmap[*s];
-                xoff += chr.width;
-                ++s;
+        glDrawArrays(GL_TRIANGLES, l.first, l.count);
+
+        glDisable(GL_BLEND);
+        glBindVertexArray(0);
+    }
+
+private:
+    // Initial size of the layout buffer (in vertices)
+    static const unsigned int INITIAL_VERTICES = 6 * 1024;
+
+    // Maximum number of cached layouts
+    static const unsigned int MAX_LAYOUTS = 64;
+
+    struct Vertex {
+        glm::vec2 xy;
+        glm::vec2 uv;
+    };
+
+    // The quads of a string, ready to be drawn
+    struct Layout {
+        int first;
+        int count;
+        float width;
+        unsigned int used;
+    };
+
+    // Get the layout of the string. If it is not cached yet, it is
+    // generated and uploaded to the buffer. The vertex array must be bound.
+    const Layout &layout(const string &text)
+    {
+        auto cached = m_layouts.find(text);
+        if(cached != m_layouts.end()) {
+            cached->second.used = ++m_clock;
+            return cached->second;
+        }
+
+        // Two triangles per glyph
+        static const int QUAD[] = { 0, 1, 3, 3, 1, 2 };
+
+        m_vertices.clear();
+        float x = 0;
+        for(char c : text) {
+            auto chr = m_charmap.find(c);
+            if(chr == m_charmap.end())
+                continue;
+
+            for(int v : QUAD) {
+                Vertex vertex = m_glyphs[chr->second.index + v];
+                vertex.xy.x += x;
+                m_vertices.push_back(vertex);
             }
-            pos.x -= xoff * scale;
+            x += chr->second.width;
         }
 
-        const char *s = text;
-        while(*s) {
-            const CharDescription &chr = m_charmap[*s];
+        Layout l { -1, int(m_vertices.size()), x, ++m_clock };
 
-            glUniform2fv(m_offset_uniform, 1, &pos[0]);
+        if(m_layouts.size() >= MAX_LAYOUTS)
+            evict();
+
+        if(l.count > 0 && m_vao) {
+            l.first = m_allocator.allocate(l.count);
+            while(l.first < 0 && !m_layouts.empty()) {
+                evict();
+                l.first = m_allocator.allocate(l.count);
+            }
+
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+            if(l.first < 0) {
+                // Nothing left to evict: the buffer is too small for this string
+                m_allocator.reset(std::max<unsigned int>(m_allocator.size() * 2, l.count));
+                glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_allocator.size(), nullptr, GL_DYNAMIC_DRAW);
+                l.first = m_allocator.allocate(l.count);
+            }
 
-            glDrawElementsBaseVertex(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, 0, chr.index);
-            pos.x += chr.width * scale;
-            ++s;
+            glBufferSubData(
+                GL_ARRAY_BUFFER,
+                sizeof(Vertex) * l.first,
+                sizeof(Vertex) * l.count,
+                m_vertices.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        } else {
+            l.count = 0;
         }
-        glDisable(GL_BLEND);
+
+        return m_layouts[text] = l;
+    }
+
+    // Remove the least recently used layout from the cache
+    void evict()
+    {
+        auto oldest = m_layouts.begin();
+        for(auto i=m_layouts.begin();i!=m_layouts.end();++i) {
+            if(i->second.used < oldest->second.used)
+                oldest = i;
+        }
+
+        if(oldest->second.count > 0)
+            m_allocator.release(oldest->second.first, oldest->second.count);
+        m_layouts.erase(oldest);
     }
 
-private:
     CharMap m_charmap;
 
-    // Our vertex, UV and element index buffers
-    GLuint m_buffers[3];
+    // Quad of each glyph. CharDescription::index is the first vertex.
+    std::vector<Vertex> m_glyphs;
+
+    // Cached string layouts
+    std::unordered_map<string, Layout> m_layouts;
+    RangeAllocator m_allocator;
+    unsigned int m_clock;
+    std::vector<Vertex> m_vertices;
+
+    // Our layout vertex buffer
+    GLuint m_buffer;
 
     // Our vertex array object
     GLuint m_vao;
@@ -316,20 +398,28 @@ Font::~Font()
 
 TextRenderer Font::text(const string &text)
 {
-    return TextRenderer(this, text.c_str());
+    return TextRenderer(this, text);
 }
 
 TextRenderer Font::text(const char *text, ...)
 {
-    static char str[512];
     va_list arguments;
     va_start(arguments, text);
-    vsnprintf(str, sizeof(str), text, arguments);
+
+    va_list copy;
+    va_copy(copy, arguments);
+    const int len = vsnprintf(nullptr, 0, text, copy);
+    va_end(copy);
+
+    string str(std::max(len, 0), '\0');
+    if(len > 0)
+        vsnprintf(&str[0], len + 1, text, arguments);
     va_end(arguments);
+
     return TextRenderer(this, str);
 }
 
-TextRenderer::TextRenderer(Font *font, const char *text)
+TextRenderer::TextRenderer(Font *font, const string &text)
     : m_font(font), m_text(text), m_scale(1.0f), m_color(1.0f), m_pos(0), m_align(LEFT)
 {
 }
@@ -39,9 +39,6 @@ class Font;
  *  .color(fps < 25 ? red : green)  // select font color
  *  .pos(1, 0).align(RIGHT)         // draw at top right corner of the screen
  *  .render()                       // render text
- *
- * Note. It is not safe to keep instances of this class around for too long.
- * Subsequent calls to Font.text() may change the text pointer.
  */
 class TextRenderer {
     friend class Font;
@@ -92,10 +89,10 @@ public:
     void render();
 
 private:
-    TextRenderer(Font *font, const char *text);
+    TextRenderer(Font *font, const string &text);
 
     Font *m_font;
-    const char *m_text;
+    string m_text;
     float m_scale;
     glm::vec4 m_color;
     glm::vec2 m_pos;
@@ -118,6 +115,10 @@ public:
      * Vertex attributes:
      *   0: vertices (vec2)
      *   1: UV coordinates
+     *
+     * Each string is drawn with a single draw call. The glyph quads
+     * of recently drawn strings are kept in a vertex buffer, so text
+     * that does not change from frame to frame is laid out only once.
      * 
      * @param name resource name
      * @param datafile the datafile from which to load the font description
@@ -217,13 +217,15 @@ Resource *Loader::loadModel(const conftree::Node &node, const string &name)
     }
 
     bool blend = node.opt("blend").value("false") == "true";
+    bool instanced = node.opt("instanced").value("false") == "true";
 
     return Model::make(
         name,
         static_cast<Mesh*>(mesh),
         static_cast<Program*>(shader),
         textures,
-        blend
+        blend,
+        instanced
         );
 }
 
@@ -181,6 +181,13 @@ Mesh *Mesh::load(
     for(glm::vec3 &vec : data.vertex)
         vec = (vec + offset) * scale;
 
+    // Only the mesh metadata is needed in headless mode
+    if(Resources::getInstance().isHeadless()) {
+        Mesh *res = new Mesh(name, 0, 0, 0, 0, 0, data.vertex.size(), data.triangle.size(), submeshes);
+        Resources::getInstance().registerResource(res);
+        return res;
+    }
+
     // Create vertex, normal, color and UV buffers
     GLuint vbId;
     glGenBuffers(1, &vbId);
@@ -250,8 +257,10 @@ Mesh::Mesh(const string& name, GLuint vertexid, GLuint elementid, GLuint normali
 
 Mesh::~Mesh()
 {
-    glDeleteBuffers(1, &m_vertex);
-    glDeleteBuffers(1, &m_element);
+    if(m_vertex) {
+        glDeleteBuffers(1, &m_vertex);
+        glDeleteBuffers(1, &m_element);
+    }
 }
 
 }
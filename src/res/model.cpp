@@ -15,6 +15,7 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <cassert>
 #include <GL/glew.h>
 
 #include "model.h"
@@ -22,6 +23,7 @@
 #include "texture.h"
 
 #include "shader.h"
+#include "../renderqueue.h"
 
 namespace resource {
 
@@ -30,57 +32,79 @@ Model *Model::make(
     Mesh *mesh,
     Program *program,
     SamplerTextures textures,
-    bool blend
+    bool blend,
+    bool instanced
     )
 {
-    // Create the vertex array object
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    // Get uniform locations
-    GLuint mvpid = glGetUniformLocation(program->id(), "MVP");
-
+    GLuint vao = 0;
+    GLuint instances = 0;
+    GLuint mvpid = 0;
     UniformTextures utextures;
-    for(const SamplerTexture &st : textures) {
-        utextures.push_back(UniformTexture(
-           glGetUniformLocation(program->id(), st.first.c_str()),
-           st.second
-           ));
-    }
-
-    // Set vertex data (0)
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBufferId());
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-    // Set normal data (1)
-    if(mesh->normalBufferId()) {
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh->normalBufferId());
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    if(Resources::getInstance().isHeadless()) {
+        // No vertex arrays or uniforms without an OpenGL context
+        for(const SamplerTexture &st : textures)
+            utextures.push_back(UniformTexture(0, st.second));
+
+    } else {
+        // Create the vertex array object
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+
+        // Get uniform locations
+        mvpid = glGetUniformLocation(program->id(), "MVP");
+
+        for(const SamplerTexture &st : textures) {
+            utextures.push_back(UniformTexture(
+               glGetUniformLocation(program->id(), st.first.c_str()),
+               st.second
+               ));
+        }
+
+        // Set vertex data (0)
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBufferId());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        // Set normal data (1)
+        if(mesh->normalBufferId()) {
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh->normalBufferId());
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        }
+
+        // Set UV data (2)
+        if(mesh->uvBufferId()) {
+            glEnableVertexAttribArray(2);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh->uvBufferId());
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        }
+
+        // TODO Set color data (3)
+
+        // Set instance data (4). The attribute pointer is set
+        // when rendering, since it depends on the first instance.
+        if(instanced) {
+            glGenBuffers(1, &instances);
+            glBindBuffer(GL_ARRAY_BUFFER, instances);
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 0, 0);
+            glVertexAttribDivisor(4, 1);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Set element index buffer
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->elementArrayId());
+
+        glBindVertexArray(0);
     }
 
-    // Set UV data (2)
-    if(mesh->uvBufferId()) {
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh->uvBufferId());
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    }
-
-    // TODO Set color data (3)
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Set element index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->elementArrayId());
-
-    glBindVertexArray(0);
-
     Model *res = new Model(
         name,
         mesh,
         vao,
+        instances,
         program->id(),
         mvpid,
         utextures,
@@ -96,64 +120,59 @@ Model *Model::make(
     return res;
 }
 
-Model::Model(const string& name, const Mesh *mesh, GLuint id, GLuint shader, GLuint mvp, const UniformTextures &textures, bool blend)
-    : Resource(name, MODEL), m_id(id), m_shader_id(shader),
+Model::Model(const string& name, const Mesh *mesh, GLuint id, GLuint instances, GLuint shader, GLuint mvp, const UniformTextures &textures, bool blend)
+    : Resource(name, MODEL), m_id(id), m_instances(instances), m_shader_id(shader),
       m_mvp_id(mvp), m_textures(textures), m_blend(blend), m_mesh(mesh)
 {
 }
 
 Model::~Model()
 {
-    glDeleteVertexArrays(1, &m_id);
+    if(m_id)
+        glDeleteVertexArrays(1, &m_id);
+    if(m_instances)
+        glDeleteBuffers(1, &m_instances);
 }
 
-void Model::prepareRender() const
+void Model::setInstances(const std::vector<glm::vec4> &instances) const
 {
-    // Bind our vertex data
-    glBindVertexArray(m_id);
-
-    // Set shader program
-    glUseProgram(m_shader_id);
-
-    // Set textures (if any)
-    int texi = 0;
-    for(const UniformTexture &t : m_textures) {
-        glActiveTexture(GL_TEXTURE0 + texi);
-        glBindTexture(t.second->target(), t.second->id());
-        glUniform1i(t.first, texi);
-        ++texi;
-    }
+    assert(m_instances);
 
-    // Blending
-    if(m_blend) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    }
-}
-
-void Model::endRender() const
-{
-    glBindVertexArray(0);
-    glUseProgram(0);
-    glDisable(GL_BLEND);
+    // Orphan the old buffer so the driver does not have to wait
+    // for the previous frame's draw calls to finish with it
+    glBindBuffer(GL_ARRAY_BUFFER, m_instances);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * instances.size(), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec4) * instances.size(), instances.data());
 }
 
-void Model::render(const glm::mat4 &transform) const
+void Model::draw(RenderQueue &queue, int layer, const glm::mat4 &transform, GLushort offset, GLsizei len) const
 {
-    glUniformMatrix4fv(m_mvp_id, 1, GL_FALSE, &transform[0][0]);
-    glDrawElements(GL_TRIANGLES, m_mesh->faceCount(), GL_UNSIGNED_SHORT, 0);
+    queue.submit(RenderQueue::Item {
+        layer, m_shader_id, m_id, &m_textures, m_blend, GLint(m_mvp_id), transform,
+        [offset, len]() {
+            glDrawElements(GL_TRIANGLES, len, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(sizeof(GLushort) * offset));
+        }
+    });
 }
 
-void Model::render(const glm::mat4 &transform, const string &name) const
+void Model::draw(RenderQueue &queue, int layer, const glm::mat4 &transform) const
 {
-    MeshSlice offset = m_mesh->submeshOffset(name);
-    render(transform, offset.first, offset.second);
+    draw(queue, layer, transform, 0, m_mesh->faceCount());
 }
 
-void Model::render(const glm::mat4 &transform, GLushort offset, GLsizei len) const
+void Model::drawInstances(RenderQueue &queue, int layer, const glm::mat4 &transform, GLushort offset, GLsizei len, GLint first, GLsizei count) const
 {
-    glUniformMatrix4fv(m_mvp_id, 1, GL_FALSE, &transform[0][0]);
-    glDrawElements(GL_TRIANGLES, len, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(sizeof(GLushort) * offset));
+    const GLuint instances = m_instances;
+    queue.submit(RenderQueue::Item {
+        layer, m_shader_id, m_id, &m_textures, m_blend, GLint(m_mvp_id), transform,
+        [instances, offset, len, first, count]() {
+            // OpenGL 3.3 has no base instance parameter, so point the
+            // instance attribute at the first instance instead
+            glBindBuffer(GL_ARRAY_BUFFER, instances);
+            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid*>(sizeof(glm::vec4) * first));
+            glDrawElementsInstanced(GL_TRIANGLES, len, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(sizeof(GLushort) * offset), count);
+        }
+    });
 }
 
 }
@@ -28,6 +28,8 @@
 
 using std::string;
 
+class RenderQueue;
+
 namespace resource {
 
 class Mesh;
@@ -54,15 +56,20 @@ public:
      * Vertex attributes (in order):
      * 0: vertices
      * 1: normals
-     * 3: UVs
-     * 4: colors
+     * 2: UVs
+     * 3: colors
+     * 4: per instance data (instanced models only)
+     *
+     * An instanced model has a streamed buffer of vec4s, one per
+     * instance. What the values mean is up to the shader.
      */
     static Model *make(
         const string& name,
         Mesh *mesh,
         Program *program,
         SamplerTextures textures,
-        bool blend
+        bool blend,
+        bool instanced
         );
 
     Model() = delete;
@@ -76,47 +83,68 @@ public:
     const Mesh *mesh() const { return m_mesh; }
 
     /**
-     * Bind vertex arrays, textures and the shader program.
+     * Check if this model can be drawn with drawInstances()
      *
-     * After this call, render() can be called repeatedly to render this model.
+     * @return true if the model has an instance buffer
      */
-    void prepareRender() const;
+    bool isInstanced() const { return m_instances != 0; }
 
     /**
-     * Render the entire mesh.
+     * Upload the per instance data.
      *
-     * Use this when rendering a mesh with no submeshes.
+     * The previous contents of the instance buffer are discarded.
+     * The buffer is read when the queued drawInstances() calls are
+     * executed, so this must be called before the render queue is
+     * flushed, and only once per flush.
      *
-     * @param transform the transformation to apply
+     * @param instances instance data
      */
-    void render(const glm::mat4 &transform) const;
+    void setInstances(const std::vector<glm::vec4> &instances) const;
 
     /**
-     * Render the named submesh.
+     * Queue the submesh for rendering.
      *
+     * The vertex array, shader program, textures and blending are set
+     * up by the render queue when the draw call is executed.
+     *
+     * @param queue the render queue
+     * @param layer the layer to draw on
      * @param transform the transformation to apply
-     * @param name the name of the submesh to render
+     * @param offset vertex element array offset
+     * @param len number of vertex elements to draw
      */
-    void render(const glm::mat4 &transform, const string &name) const;
+    void draw(RenderQueue &queue, int layer, const glm::mat4 &transform, GLushort offset, GLsizei len) const;
 
     /**
-     * Render the submesh.
+     * Queue the whole mesh for rendering.
      *
+     * @param queue the render queue
+     * @param layer the layer to draw on
      * @param transform the transformation to apply
-     * @param offset vertex element array offset
-     * @param len number of vertex elements to draw
      */
-    void render(const glm::mat4 &transform, GLushort offset, GLsizei len) const;
+    void draw(RenderQueue &queue, int layer, const glm::mat4 &transform) const;
 
     /**
-     * Clean up after rendering
+     * Queue many instances of the submesh for rendering with one draw call.
+     *
+     * The instance data must have been set with setInstances() before
+     * the queue is flushed.
+     *
+     * @param queue the render queue
+     * @param layer the layer to draw on
+     * @param transform the transformation to apply to all instances
+     * @param offset vertex element array offset
+     * @param len number of vertex elements to draw
+     * @param first index of the first instance in the instance buffer
+     * @param count number of instances to draw
      */
-    void endRender() const;
+    void drawInstances(RenderQueue &queue, int layer, const glm::mat4 &transform, GLushort offset, GLsizei len, GLint first, GLsizei count) const;
 
 private:
-    Model(const string& name, const Mesh *mesh, GLuint m_id, GLuint shader, GLuint mvp, const UniformTextures &textures, bool blend);
+    Model(const string& name, const Mesh *mesh, GLuint m_id, GLuint instances, GLuint shader, GLuint mvp, const UniformTextures &textures, bool blend);
 
     GLuint m_id;
+    GLuint m_instances;
     GLuint m_shader_id;
     GLuint m_mvp_id;
     UniformTextures m_textures;
@@ -26,6 +26,7 @@ namespace {
 }
 
 Resources::Resources()
+    : m_headless(false)
 {
 }
 
@@ -178,10 +178,32 @@ public:
      */
     void unloadResource(const string& name);
 
+    /**
+     * Enable or disable headless mode.
+     *
+     * In headless mode, no OpenGL context is available. Resources are still
+     * loaded and registered normally (so that game data referring to them
+     * works), but no OpenGL objects are created for them and their
+     * OpenGL object IDs will be zero.
+     *
+     * This must be set before any resources are loaded.
+     *
+     * @param headless enable headless mode
+     */
+    void setHeadless(bool headless) { m_headless = headless; }
+
+    /**
+     * Check if headless mode is enabled.
+     *
+     * @return true if there is no OpenGL context
+     */
+    bool isHeadless() const { return m_headless; }
+
 private:
     Resources();
 
     std::unordered_map<string, Resource*> m_resources;
+    bool m_headless;
 };
 
 /**
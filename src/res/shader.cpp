@@ -49,6 +49,13 @@ Shader *Shader::load(
     if(ds->isError())
         throw ResourceException(datafile.name(), name, ds->errorString());
 
+    // No shaders to compile in headless mode
+    if(Resources::getInstance().isHeadless()) {
+        Shader *res = new Shader(name, type, 0);
+        Resources::getInstance().registerResource(res);
+        return res;
+    }
+
     // Compile Vertex Shader
     GLenum shaderType;
     switch(type) {
@@ -93,12 +100,16 @@ Shader::Shader(const string& name, Type type, GLuint id)
 
 Shader::~Shader()
 {
-    glDeleteShader(m_id);
+    if(m_id)
+        glDeleteShader(m_id);
 }
 
 Program *Program::make(const string& name)
 {
-    GLuint id = glCreateProgram();
+    GLuint id = 0;
+    if(!Resources::getInstance().isHeadless())
+        id = glCreateProgram();
+
     Program *res = new Program(name, id);
     Resources::getInstance().registerResource(res);
     return res;
@@ -111,7 +122,8 @@ Program::Program(const string& name, GLuint id)
 
 Program::~Program()
 {
-    glDeleteProgram(m_id);
+    if(m_id)
+        glDeleteProgram(m_id);
 }
 
 void Program::addShader(Shader *shader)
@@ -121,7 +133,8 @@ void Program::addShader(Shader *shader)
     if(!shader)
         throw ResourceException("", name(), "tried to add null shader to this program");
 
-    glAttachShader(m_id, shader->id());
+    if(m_id)
+        glAttachShader(m_id, shader->id());
     addDependency(shader);
 }
 
@@ -130,6 +143,12 @@ void Program::link()
 #ifndef NDEBUG
     cerr << "Linking shader program " << name() << "..." << endl;
 #endif
+    if(!m_id) {
+        // Headless mode
+        m_linked = true;
+        return;
+    }
+
     glLinkProgram(m_id);
 
     // Check the program
@@ -48,6 +48,14 @@ Texture *Texture::load(const string& name, fs::DataFile &datafile, const string&
 
     Image img = loadPng(datafile, filename);
 
+    // Just the image dimensions are needed in headless mode
+    if(Resources::getInstance().isHeadless()) {
+        delete[] img.data;
+        Texture *res = new Texture(name, 0, img.width, img.height, GL_TEXTURE_2D);
+        Resources::getInstance().registerResource(res);
+        return res;
+    }
+
     GLuint id;
     glGenTextures(1, &id);
 
@@ -77,7 +85,8 @@ Texture::Texture(const string& name, GLuint id, int width, int height, GLenum ta
 
 Texture::~Texture()
 {
-    glDeleteTextures(1, &m_id);
+    if(m_id)
+        glDeleteTextures(1, &m_id);
 }
 
 namespace {
@@ -15,10 +15,8 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
-#include <glm/gtc/matrix_transform.hpp>
 #include <cmath>
 
-#include "../res/model.h"
 #include "../gameinit.h"
 
 #include "shipdef.h"
@@ -100,21 +98,6 @@ void Ship::addBattery(float capacity, float chargerate)
     m_battery_charge_rate = (m_battery_charge_rate + chargerate) / 2.0f;
 }
 
-void Ship::draw(const glm::mat4 &transform) const
-{
-    static const glm::vec3 axis(0, 0, 1);
-
-    glm::mat4 m = glm::rotate(
-        glm::translate(
-            transform,
-            glm::vec3(m_physics.position(), 0.0f)),
-        glm::degrees(m_angle) - 90,
-        axis);
-
-    m_model->prepareRender();
-    m_model->render(m);
-}
-
 void Ship::setAngle(float a)
 {
     assert(0 <= a && a <= 2*M_PI);
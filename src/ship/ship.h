@@ -116,11 +116,11 @@ public:
     void addBattery(float capacity, float chargerate);
 
     /**
-     * Draw the ship
-     * 
-     * @param transform
+     * Get the ship's model
+     *
+     * @return model
      */
-    void draw(const glm::mat4 &transform) const;
+    const resource::Model *model() const { return m_model; }
 
     /**
      * Get the currently stored amount of energy
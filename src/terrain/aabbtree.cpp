@@ -0,0 +1,309 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+
+#include "aabbtree.h"
+
+namespace terrain {
+
+namespace {
+    // Insertion cost heuristic. For 2D boxes, the perimeter is
+    // a better measure than the area.
+    float perimeter(const BRect &r)
+    {
+        return 2 * (r.width() + r.height());
+    }
+}
+
+AABBTree::AABBTree()
+    : m_root(NULL_NODE), m_freelist(NULL_NODE), m_leaves(0)
+{
+}
+
+void AABBTree::clear()
+{
+    m_nodes.clear();
+    m_root = NULL_NODE;
+    m_freelist = NULL_NODE;
+    m_leaves = 0;
+}
+
+int AABBTree::allocateNode()
+{
+    int node;
+    if(m_freelist != NULL_NODE) {
+        node = m_freelist;
+        m_freelist = m_nodes[node].next;
+    } else {
+        node = m_nodes.size();
+        m_nodes.push_back(Node());
+    }
+
+    Node &n = m_nodes[node];
+    n.parent = NULL_NODE;
+    n.left = NULL_NODE;
+    n.right = NULL_NODE;
+    n.height = 0;
+    n.data = 0;
+    return node;
+}
+
+void AABBTree::freeNode(int node)
+{
+    m_nodes[node].next = m_freelist;
+    m_nodes[node].height = -1;
+    m_freelist = node;
+}
+
+int AABBTree::insert(const BRect &box, unsigned int data)
+{
+    const int leaf = allocateNode();
+    m_nodes[leaf].box = box;
+    m_nodes[leaf].data = data;
+
+    insertLeaf(leaf);
+    ++m_leaves;
+    return leaf;
+}
+
+void AABBTree::remove(int proxy)
+{
+    assert(proxy >= 0 && proxy < int(m_nodes.size()));
+    assert(m_nodes[proxy].isLeaf() && m_nodes[proxy].height == 0);
+
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --m_leaves;
+}
+
+void AABBTree::update(int proxy, const BRect &box)
+{
+    assert(m_nodes[proxy].isLeaf());
+
+    removeLeaf(proxy);
+    m_nodes[proxy].box = box;
+    insertLeaf(proxy);
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+    if(m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Find the best sibling for the new leaf by descending
+    // into the child whose cost grows the least.
+    const BRect box = m_nodes[leaf].box;
+    int index = m_root;
+    while(!m_nodes[index].isLeaf()) {
+        const Node &node = m_nodes[index];
+
+        const float area = perimeter(node.box);
+        const float combined = perimeter(node.box.united(box));
+
+        // Cost of making a new parent for this node and the leaf
+        const float cost = 2 * combined;
+
+        // Minimum cost of pushing the leaf further down
+        const float inheritance = 2 * (combined - area);
+
+        float childcost[2];
+        const int children[2] = { node.left, node.right };
+        for(int i=0;i<2;++i) {
+            const Node &child = m_nodes[children[i]];
+            const float c = perimeter(child.box.united(box));
+            if(child.isLeaf())
+                childcost[i] = c + inheritance;
+            else
+                childcost[i] = c - perimeter(child.box) + inheritance;
+        }
+
+        if(cost < childcost[0] && cost < childcost[1])
+            break;
+
+        index = childcost[0] < childcost[1] ? node.left : node.right;
+    }
+
+    // Make a new parent for the sibling and the leaf
+    const int sibling = index;
+    const int oldparent = m_nodes[sibling].parent;
+    const int newparent = allocateNode();
+
+    m_nodes[newparent].parent = oldparent;
+    m_nodes[newparent].box = box.united(m_nodes[sibling].box);
+    m_nodes[newparent].height = m_nodes[sibling].height + 1;
+    m_nodes[newparent].left = sibling;
+    m_nodes[newparent].right = leaf;
+    m_nodes[sibling].parent = newparent;
+    m_nodes[leaf].parent = newparent;
+
+    if(oldparent == NULL_NODE) {
+        m_root = newparent;
+    } else {
+        if(m_nodes[oldparent].left == sibling)
+            m_nodes[oldparent].left = newparent;
+        else
+            m_nodes[oldparent].right = newparent;
+    }
+
+    refit(m_nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+    if(leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const int parent = m_nodes[leaf].parent;
+    const int grandparent = m_nodes[parent].parent;
+    const int sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    // The sibling takes the place of the parent
+    if(grandparent == NULL_NODE) {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+    } else {
+        if(m_nodes[grandparent].left == parent)
+            m_nodes[grandparent].left = sibling;
+        else
+            m_nodes[grandparent].right = sibling;
+        m_nodes[sibling].parent = grandparent;
+    }
+    freeNode(parent);
+
+    refit(grandparent);
+}
+
+void AABBTree::refit(int index)
+{
+    // Walk up the tree fixing boxes and heights
+    while(index != NULL_NODE) {
+        index = balance(index);
+
+        Node &node = m_nodes[index];
+        const Node &left = m_nodes[node.left];
+        const Node &right = m_nodes[node.right];
+
+        node.height = 1 + std::max(left.height, right.height);
+        node.box = left.box.united(right.box);
+
+        index = node.parent;
+    }
+}
+
+int AABBTree::balance(int a)
+{
+    // Perform a left or right rotation if node A is imbalanced.
+    // Returns the new root of this subtree.
+    Node &A = m_nodes[a];
+    if(A.isLeaf() || A.height < 2)
+        return a;
+
+    const int b = A.left;
+    const int c = A.right;
+    Node &B = m_nodes[b];
+    Node &C = m_nodes[c];
+
+    const int diff = C.height - B.height;
+
+    if(diff > 1) {
+        // Rotate C up
+        const int f = C.left;
+        const int g = C.right;
+        Node &F = m_nodes[f];
+        Node &G = m_nodes[g];
+
+        C.left = a;
+        C.parent = A.parent;
+        A.parent = c;
+
+        if(C.parent == NULL_NODE)
+            m_root = c;
+        else if(m_nodes[C.parent].left == a)
+            m_nodes[C.parent].left = c;
+        else
+            m_nodes[C.parent].right = c;
+
+        // The taller grandchild stays with C
+        if(F.height > G.height) {
+            C.right = f;
+            A.right = g;
+            G.parent = a;
+            A.box = B.box.united(G.box);
+            C.box = A.box.united(F.box);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        } else {
+            C.right = g;
+            A.right = f;
+            F.parent = a;
+            A.box = B.box.united(F.box);
+            C.box = A.box.united(G.box);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+        return c;
+    }
+
+    if(diff < -1) {
+        // Rotate B up
+        const int d = B.left;
+        const int e = B.right;
+        Node &D = m_nodes[d];
+        Node &E = m_nodes[e];
+
+        B.left = a;
+        B.parent = A.parent;
+        A.parent = b;
+
+        if(B.parent == NULL_NODE)
+            m_root = b;
+        else if(m_nodes[B.parent].left == a)
+            m_nodes[B.parent].left = b;
+        else
+            m_nodes[B.parent].right = b;
+
+        if(D.height > E.height) {
+            B.right = d;
+            A.left = e;
+            E.parent = a;
+            A.box = C.box.united(E.box);
+            B.box = A.box.united(D.box);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        } else {
+            B.right = e;
+            A.left = d;
+            D.parent = a;
+            A.box = C.box.united(D.box);
+            B.box = A.box.united(E.box);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+        return b;
+    }
+
+    return a;
+}
+
+}
+
@@ -0,0 +1,194 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_AABBTREE_H
+#define LUOLA_TERRAIN_AABBTREE_H
+
+#include <cassert>
+#include <vector>
+
+#include "bounds.h"
+
+namespace terrain {
+
+/**
+ * A dynamic bounding volume hierarchy of axis aligned boxes.
+ *
+ * Each leaf holds a box and a user data value (typically an index into
+ * some other list.) Leaves can be inserted and removed at any time and
+ * the tree is kept balanced using tree rotations, so queries visit
+ * only O(log n) nodes plus the actual hits.
+ *
+ * Leaves are referred to by proxy IDs, which remain stable until
+ * the leaf is removed.
+ */
+class AABBTree {
+public:
+    static const int NULL_NODE = -1;
+
+    AABBTree();
+
+    /**
+     * Insert a new leaf.
+     *
+     * @param box leaf bounding box
+     * @param data user data
+     * @return proxy ID
+     */
+    int insert(const BRect &box, unsigned int data);
+
+    /**
+     * Remove a leaf.
+     *
+     * @param proxy proxy ID returned by insert()
+     */
+    void remove(int proxy);
+
+    /**
+     * Change the bounding box of a leaf.
+     *
+     * @param proxy proxy ID
+     * @param box new bounding box
+     */
+    void update(int proxy, const BRect &box);
+
+    /**
+     * Remove all leaves.
+     */
+    void clear();
+
+    /**
+     * Get the user data of a leaf.
+     *
+     * @param proxy proxy ID
+     * @return user data
+     */
+    unsigned int data(int proxy) const { return m_nodes[proxy].data; }
+
+    /**
+     * Change the user data of a leaf.
+     *
+     * @param proxy proxy ID
+     * @param data new user data
+     */
+    void setData(int proxy, unsigned int data) { m_nodes[proxy].data = data; }
+
+    /**
+     * Get the bounding box of a leaf.
+     *
+     * @param proxy proxy ID
+     * @return leaf box
+     */
+    const BRect &box(int proxy) const { return m_nodes[proxy].box; }
+
+    /**
+     * Get the number of leaves in the tree.
+     *
+     * @return leaf count
+     */
+    unsigned int size() const { return m_leaves; }
+
+    /**
+     * Check if the tree has no leaves.
+     *
+     * @return true if empty
+     */
+    bool isEmpty() const { return m_root == NULL_NODE; }
+
+    /**
+     * Get the bounding box of the whole tree.
+     *
+     * Must not be called on an empty tree.
+     *
+     * @return box containing all leaves
+     */
+    const BRect &bounds() const { assert(!isEmpty()); return m_nodes[m_root].box; }
+
+    /**
+     * Find all leaves whose boxes overlap the given box.
+     *
+     * The callback is called with the user data of each leaf.
+     * Touching boxes are considered overlapping. The tree must not be
+     * modified during the query.
+     *
+     * @param box the box to test
+     * @param fn callback function: void fn(unsigned int data)
+     */
+    template<typename Function> void query(const BRect &box, Function fn) const
+    {
+        if(m_root == NULL_NODE)
+            return;
+
+        int stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = m_root;
+
+        while(top > 0) {
+            const Node &node = m_nodes[stack[--top]];
+            if(!touches(node.box, box))
+                continue;
+
+            if(node.isLeaf()) {
+                fn(node.data);
+            } else {
+                assert(top + 2 <= MAX_DEPTH);
+                stack[top++] = node.right;
+                stack[top++] = node.left;
+            }
+        }
+    }
+
+private:
+    // A balanced tree with 2^32 leaves is shallower than this
+    static const int MAX_DEPTH = 96;
+
+    struct Node {
+        BRect box;
+        union {
+            int parent;
+            int next; // free list link
+        };
+        int left, right;
+        int height; // leaf = 0, free node = -1
+        unsigned int data;
+
+        bool isLeaf() const { return left == NULL_NODE; }
+    };
+
+    static bool touches(const BRect &a, const BRect &b)
+    {
+        return a.left() <= b.right() && a.right() >= b.left() &&
+            a.bottom() <= b.top() && a.top() >= b.bottom();
+    }
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void refit(int node);
+    int balance(int node);
+
+    std::vector<Node> m_nodes;
+    int m_root;
+    int m_freelist;
+    unsigned int m_leaves;
+};
+
+}
+
+#endif
+
@@ -22,7 +22,6 @@ using std::endl;
 #endif
 
 #include <exception>
-#include <unordered_set>
 #include <unordered_map>
 #include <algorithm>
 
@@ -31,93 +30,222 @@ using std::endl;
 namespace terrain {
 namespace algorithm {
 
-// Triangulation code based on snippet by John W. Ratcliff
-// http://www.flipcode.com/archives/Efficient_Polygon_Triangulation.shtml
+/*
+ * Ear clipping triangulation.
+ *
+ * The remaining polygon is kept as a doubly linked ring, so clipping
+ * an ear is O(1). Only reflex vertices can be inside an ear, so the
+ * ear test checks just the reflex vertices in the grid cells the ear's
+ * bounding box touches, instead of every remaining vertex. Clipping an
+ * ear can only make its two neighbours convex, so only those are
+ * retested. Vertices that are collinear with their neighbours are
+ * treated as reflex: they are never clipped as ears on their own and
+ * they block ears that would cover them.
+ *
+ * The polygon must be simple and in counterclockwise order.
+ */
 namespace {
 
 static const float EPSILON=0.0000000001f;
 
-bool triSnip(const Points &contour, int u, int v, int w, int n, const std::vector<int> &V)
-{
-    int p;
+class EarClipper {
+public:
+    EarClipper(const Points &contour)
+        : m_contour(contour), m_nodes(contour.size())
+    {
+        const int n = contour.size();
+        for(int i=0;i<n;++i) {
+            m_nodes[i].prev = i==0 ? n-1 : i-1;
+            m_nodes[i].next = i==n-1 ? 0 : i+1;
+        }
 
-    const Point &A = contour[V[u]];
-    const Point &B = contour[V[v]];
-    const Point &C = contour[V[w]];
+        int reflexcount = 0;
+        for(int i=0;i<n;++i) {
+            m_nodes[i].reflex = !isConvex(i);
+            if(m_nodes[i].reflex)
+                ++reflexcount;
+        }
 
-    if( EPSILON > (((B.x-A.x) * (C.y-A.y)) - ((B.y-A.y) * (C.x-A.x))))
-        return false;
+        buildGrid(reflexcount);
+    }
 
-    for (p=0;p<n;p++)
+    std::vector<int> run()
     {
-        if((p == u) || (p == v) || (p == w))
-            continue;
-
-        if (pointInTriangle(A,B,C,contour[V[p]]))
-            return false;
-    }
+        std::vector<int> result;
+        int nv = m_contour.size();
+        result.reserve(3 * (nv - 2));
+
+        // Walk around the ring clipping ears. If we go all the way
+        // around without finding one, it is probably a non-simple polygon.
+        int v = 0;
+        int count = nv;
+        while(nv > 2) {
+            if(0 >= (count--))
+                throw GeometryException("loop encountered while triangulating polygon!");
+
+            if(!isEar(v)) {
+                v = m_nodes[v].next;
+                continue;
+            }
 
-    return true;
-}
+            const int u = m_nodes[v].prev;
+            const int w = m_nodes[v].next;
+            result.push_back(u);
+            result.push_back(v);
+            result.push_back(w);
 
-std::vector<int> triProcess(const Points &contour)
-{
-    /* allocate and initialize list of Vertices in polygon */
-    int n = contour.size();
-    if(n < 3)
-        throw GeometryException("polygon has less than 3 points");
+            // Remove v from the remaining polygon
+            m_nodes[u].next = w;
+            m_nodes[w].prev = u;
+            --nv;
 
-    std::vector<int> result;
-    std::vector<int> V(n);
+            // The neighbours may have become convex
+            updateReflex(u);
+            updateReflex(w);
 
-    for(int v=0; v<n; v++)
-        V[v] = v;
+            v = w;
+            count = nv;
+        }
 
-    int nv = n;
+        return result;
+    }
 
-    /*  remove nv-2 Vertices, creating 1 triangle every time */
-    int count = 2*nv;   /* error detection */
+private:
+    bool isConvex(int v) const
+    {
+        const Point &A = m_contour[m_nodes[v].prev];
+        const Point &B = m_contour[v];
+        const Point &C = m_contour[m_nodes[v].next];
+        return ((B.x-A.x) * (C.y-A.y)) - ((B.y-A.y) * (C.x-A.x)) > EPSILON;
+    }
 
-    for(int m=0, v=nv-1; nv>2; )
+    bool isEar(int v) const
     {
-        /* if we loop, it is probably a non-simple polygon */
-        if (0 >= (count--)) {
-            //** Triangulate: ERROR - probable bad polygon!
-            throw GeometryException("loop encountered while triangulating polygon!");
+        // The reflex flag is not trusted here: with a non-simple
+        // polygon, clipping can make a convex vertex reflex.
+        if(!isConvex(v))
+            return false;
+
+        const int u = m_nodes[v].prev;
+        const int w = m_nodes[v].next;
+        const Point &A = m_contour[u];
+        const Point &B = m_contour[v];
+        const Point &C = m_contour[w];
+
+        int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+        if(m_width > 1 || m_height > 1) {
+            x0 = cellX(std::min(A.x, std::min(B.x, C.x)));
+            x1 = cellX(std::max(A.x, std::max(B.x, C.x)));
+            y0 = cellY(std::min(A.y, std::min(B.y, C.y)));
+            y1 = cellY(std::max(A.y, std::max(B.y, C.y)));
         }
 
-        /* three consecutive vertices in current polygon, <u,v,w> */
-        int u = v  ;
-        if (nv <= u)
-            u = 0;     /* previous */
+        for(int y=y0;y<=y1;++y) {
+            for(int x=x0;x<=x1;++x) {
+                const int cell = y * m_width + x;
+                for(int i=m_grid[cell];i<m_grid[cell+1];++i) {
+                    const int r = m_grid[i];
+                    if(r == u || r == w || !m_nodes[r].reflex)
+                        continue;
+                    if(pointInTriangle(A, B, C, m_contour[r]))
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
 
-        v = u+1;
-        if (nv <= v)
-            v = 0;     /* new v    */
+    void updateReflex(int v)
+    {
+        // A convex vertex never becomes reflex by clipping a neighbouring
+        // ear. Reflex vertices that turn convex are left in the grid,
+        // but are skipped.
+        if(m_nodes[v].reflex && isConvex(v))
+            m_nodes[v].reflex = false;
+    }
 
-        int w = v+1;
-        if (nv <= w)
-            w = 0;     /* next     */
+    // Put the reflex vertices in a uniform grid with about one vertex per cell.
+    // Small polygons get just one cell.
+    void buildGrid(int reflexcount)
+    {
+        m_width = m_height = 1;
 
-        if(triSnip(contour, u, v, w, nv, V)) {
-            /* output Triangle */
-            result.push_back(V[u]);
-            result.push_back(V[v]);
-            result.push_back(V[w]);
+        if(reflexcount > MIN_GRID_REFLEX) {
+            Point min = m_contour[0], max = m_contour[0];
+            for(const Point &p : m_contour) {
+                min = glm::min(min, p);
+                max = glm::max(max, p);
+            }
 
-            m++;
+            const Point size = max - min;
+            if(size.x > 0 && size.y > 0) {
+                const float cellsize = std::sqrt(size.x * size.y / reflexcount);
+                m_width = std::min(MAX_GRID, int(size.x / cellsize) + 1);
+                m_height = std::min(MAX_GRID, int(size.y / cellsize) + 1);
+                m_min = min;
+                m_scale = Point(m_width / size.x, m_height / size.y);
+            }
+        }
 
-            /* remove v from remaining polygon */
-            for(int s=v,t=v+1;t<nv;s++,t++)
-                V[s] = V[t];
-            nv--;
+        // Count the vertices in each cell, turn the counts into
+        // end indices and then fill the cells from the end.
+        const int cells = m_width * m_height;
+        m_grid.assign(cells + 1 + reflexcount, 0);
+        for(unsigned int i=0;i<m_contour.size();++i) {
+            if(m_nodes[i].reflex)
+                ++m_grid[cellOf(m_contour[i])];
+        }
 
-            /* resest error detection counter */
-            count = 2*nv;
+        int end = cells + 1;
+        for(int c=0;c<cells;++c) {
+            end += m_grid[c];
+            m_grid[c] = end;
+        }
+        m_grid[cells] = end;
+
+        for(unsigned int i=0;i<m_contour.size();++i) {
+            if(m_nodes[i].reflex)
+                m_grid[--m_grid[cellOf(m_contour[i])]] = i;
         }
     }
 
-    return result;
+    int cellX(float x) const { return std::min(m_width - 1, int((x - m_min.x) * m_scale.x)); }
+    int cellY(float y) const { return std::min(m_height - 1, int((y - m_min.y) * m_scale.y)); }
+
+    int cellOf(const Point &p) const
+    {
+        if(m_width == 1 && m_height == 1)
+            return 0;
+        return cellY(p.y) * m_width + cellX(p.x);
+    }
+
+    static const int MIN_GRID_REFLEX = 16;
+    static const int MAX_GRID = 256;
+
+    // A vertex in the ring. Clipped vertices keep their
+    // last values, but are never looked at again.
+    struct Node {
+        int prev, next;
+        bool reflex;
+    };
+
+    const Points &m_contour;
+    std::vector<Node> m_nodes;
+
+    // Grid of reflex vertices. The first width*height+1 entries
+    // are cell start indices into the same array: the vertices of
+    // cell c are m_grid[m_grid[c]..m_grid[c+1]-1]
+    std::vector<int> m_grid;
+    Point m_min, m_scale;
+    int m_width, m_height;
+};
+
+std::vector<int> triProcess(const Points &contour)
+{
+    if(contour.size() < 3)
+        throw GeometryException("polygon has less than 3 points");
+
+    return EarClipper(contour).run();
 }
 
 }
@@ -144,12 +272,13 @@ std::vector<Points> triangulate(const Points &polygon)
     std::vector<Points> out;
     std::vector<int> triangles = triProcess(polygon);
 
+    out.reserve(triangles.size() / 3);
     for(unsigned int i=0;i<triangles.size();i+=3) {
-        Points tri;
-        tri.push_back(polygon[triangles[i]]);
-        tri.push_back(polygon[triangles[i+1]]);
-        tri.push_back(polygon[triangles[i+2]]);
-        out.push_back(std::move(tri));
+        out.push_back(Points {
+            polygon[triangles[i]],
+            polygon[triangles[i+1]],
+            polygon[triangles[i+2]]
+        });
     }
     return out;
 }
@@ -169,21 +298,15 @@ namespace {
         bool removed;
     };
 
-    void addDiagonal(const std::vector<int> &triangles, int i, int j, int c, std::vector<Diagonal> &diagonals, std::unordered_set<int> &dset)
+    void addDiagonal(const std::vector<int> &triangles, int i, int j, int c, std::vector<Diagonal> &diagonals)
     {
         unsigned int p1 = triangles[i], p2 = triangles[j];
-        // This is a diagonal if the two points are not consecutive
-        if((p1+1)%c != p2) {
-            if(p2<p1)
-                std::swap(p1, p2);
-
-            // Store only unique diagonals
-            int id = p1 * 1024 + p2;
-            if(!dset.count(id)) {
-                dset.insert(id);
-                diagonals.push_back(Diagonal(p1, p2));
-            }
-        }
+        // This is a diagonal if the two points are not consecutive.
+        // The triangles are all counterclockwise, so each diagonal is
+        // shared by two triangles going in opposite directions.
+        // Store only the ascending one to keep the diagonals unique.
+        if((p1+1)%c != p2 && p1 < p2)
+            diagonals.push_back(Diagonal(p1, p2));
     }
 
     void polySplit(const Points &edges, const std::vector<Diagonal> &diagonals, unsigned int i, unsigned int d, std::vector<bool> &visited, std::vector<Points> &out)
@@ -334,12 +457,11 @@ std::vector<Points> fastPartition(const Points &polygon)
     // Every edge not part of the outline is a diagonal.
     // Outline edges are all consecutive.
     std::vector<Diagonal> diagonals;
-    std::unordered_set<int> dset;
     const int c = polygon.size();
     for(unsigned int i=0;i<triangles.size();i+=3) {
-        addDiagonal(triangles, i,   i+1, c, diagonals, dset);
-        addDiagonal(triangles, i+1, i+2, c, diagonals, dset);
-        addDiagonal(triangles, i+2, i,   c, diagonals, dset);
+        addDiagonal(triangles, i,   i+1, c, diagonals);
+        addDiagonal(triangles, i+1, i+2, c, diagonals);
+        addDiagonal(triangles, i+2, i,   c, diagonals);
     }
 
     // Order diagonal list: v1 ascending, v2 descending
@@ -57,4 +57,19 @@ bool BRect::overlaps(const BRect &other) const
     top() > other.bottom() && bottom() < other.top();
 }
 
+BRect BRect::united(const BRect &other) const
+{
+    return BRect(
+        glm::min(m_btmleft, other.m_btmleft),
+        glm::max(m_topright, other.m_topright)
+        );
+}
+
+BRect sweptCircleBounds(const Point &p, float r, const glm::vec2 &v)
+{
+    const Point p1 = p + v;
+    const glm::vec2 rv(r, r);
+    return BRect(glm::min(p, p1) - rv, glm::max(p, p1) + rv);
+}
+
 }
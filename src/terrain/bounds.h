@@ -115,10 +115,28 @@ public:
      */
     bool overlaps(const BRect &other) const;
 
+    /**
+     * Get the smallest rectangle that contains both this and the other one.
+     *
+     * @param other the other rectangle
+     * @return union of the two rectangles
+     */
+    BRect united(const BRect &other) const;
+
 private:
     Point m_btmleft, m_topright;
 };
 
+/**
+ * Get the bounding rectangle of the area swept by a moving circle.
+ *
+ * @param p circle center point
+ * @param r circle radius
+ * @param v circle displacement
+ * @return bounding rectangle
+ */
+BRect sweptCircleBounds(const Point &p, float r, const glm::vec2 &v);
+
 }
 
 #endif
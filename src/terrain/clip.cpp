@@ -0,0 +1,195 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <cstdint>
+
+#include "clip.h"
+
+namespace terrain {
+
+namespace {
+    // Grid resolution: units are divided into this many steps
+    const float SCALE = 16384.0f;
+
+    // Pieces with a smaller doubled area (in grid units) are dropped.
+    // This is one grid step times one unit.
+    const int64_t MIN_AREA2 = 2 * int64_t(SCALE);
+
+    struct IPoint {
+        int64_t x, y;
+    };
+
+    typedef std::vector<IPoint> IPoints;
+
+    int64_t cross(const IPoint &o, const IPoint &a, const IPoint &b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+
+    int64_t area2(const IPoints &points)
+    {
+        int64_t a = 0;
+        for(unsigned int i=0;i<points.size();++i) {
+            const IPoint &p = points[i];
+            const IPoint &q = points[(i+1) % points.size()];
+            a += p.x * q.y - p.y * q.x;
+        }
+        return a;
+    }
+
+    /*
+     * Remove duplicate, collinear and reflex vertices.
+     *
+     * Rounding intersection points to the grid can make a vertex
+     * slightly reflex. Removing it keeps the polygon strictly convex
+     * while moving the outline by less than one grid step.
+     * If less than three vertices remain, the polygon is cleared.
+     */
+    void makeConvex(IPoints &points)
+    {
+        bool changed = true;
+        while(changed && points.size() >= 3) {
+            changed = false;
+            for(unsigned int i=0;i<points.size() && points.size() >= 3;) {
+                const unsigned int n = points.size();
+                if(cross(points[(i+n-1) % n], points[i], points[(i+1) % n]) <= 0) {
+                    points.erase(points.begin() + i);
+                    changed = true;
+                } else {
+                    ++i;
+                }
+            }
+        }
+        if(points.size() < 3)
+            points.clear();
+    }
+
+    IPoints snap(const ConvexPolygon &polygon)
+    {
+        IPoints points;
+        points.reserve(polygon.vertexCount());
+        for(const Point &p : polygon.vertices())
+            points.push_back(IPoint { std::llround(p.x * SCALE), std::llround(p.y * SCALE) });
+        makeConvex(points);
+        return points;
+    }
+
+    ConvexPolygon unsnap(const IPoints &points)
+    {
+        Points fp;
+        fp.reserve(points.size());
+        for(const IPoint &p : points)
+            fp.push_back(Point(p.x / SCALE, p.y / SCALE));
+        return ConvexPolygon(fp);
+    }
+
+    /*
+     * Split a polygon along the line a-b.
+     *
+     * The part on the left side of the line goes to inner and the
+     * part on the right side to outer. Vertices on the line go to both.
+     */
+    void split(const IPoints &points, const IPoint &a, const IPoint &b, IPoints &inner, IPoints &outer)
+    {
+        inner.clear();
+        outer.clear();
+
+        const unsigned int n = points.size();
+        int64_t scur = cross(a, b, points[0]);
+        for(unsigned int i=0;i<n;++i) {
+            const IPoint &cur = points[i];
+            const IPoint &next = points[(i+1) % n];
+            const int64_t snext = cross(a, b, next);
+
+            if(scur >= 0)
+                inner.push_back(cur);
+            if(scur <= 0)
+                outer.push_back(cur);
+
+            if((scur > 0 && snext < 0) || (scur < 0 && snext > 0)) {
+                // The side values can be too large to multiply together,
+                // so the intersection point is rounded in floating point.
+                const double t = double(scur) / double(scur - snext);
+                const IPoint x {
+                    cur.x + std::llround((next.x - cur.x) * t),
+                    cur.y + std::llround((next.y - cur.y) * t)
+                };
+                inner.push_back(x);
+                outer.push_back(x);
+            }
+
+            scur = snext;
+        }
+
+        makeConvex(inner);
+        makeConvex(outer);
+    }
+
+    // Check if all points are on the given side of the line a-b
+    bool allOnSide(const IPoints &points, const IPoint &a, const IPoint &b, int side)
+    {
+        for(const IPoint &p : points) {
+            if(cross(a, b, p) * side < 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+bool fixedDifference(const ConvexPolygon &polygon, const ConvexPolygon &hole, std::vector<ConvexPolygon> &list)
+{
+    const IPoints poly = snap(polygon);
+    const IPoints h = snap(hole);
+
+    // A hole that vanishes on the grid does nothing and
+    // a polygon that vanishes on the grid is a sliver anyway.
+    if(h.empty()) {
+        list.push_back(polygon);
+        return true;
+    }
+    if(poly.empty())
+        return true;
+
+    // Special cases: separated by a hole edge or entirely inside the hole
+    bool inside = true;
+    for(unsigned int i=0;i<h.size();++i) {
+        const IPoint &a = h[i];
+        const IPoint &b = h[(i+1) % h.size()];
+        if(allOnSide(poly, a, b, -1)) {
+            list.push_back(polygon);
+            return true;
+        }
+        if(inside && !allOnSide(poly, a, b, 1))
+            inside = false;
+    }
+    if(inside)
+        return true;
+
+    // Peel off the parts outside each hole edge
+    IPoints remaining = poly, inner, outer;
+    for(unsigned int i=0;i<h.size() && !remaining.empty();++i) {
+        split(remaining, h[i], h[(i+1) % h.size()], inner, outer);
+        if(!outer.empty() && area2(outer) >= MIN_AREA2)
+            list.push_back(unsnap(outer));
+        remaining.swap(inner);
+    }
+
+    return true;
+}
+
+}
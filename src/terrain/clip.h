@@ -0,0 +1,76 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_CLIP_H
+#define LUOLA_TERRAIN_CLIP_H
+
+#include "polygon.h"
+
+namespace terrain {
+
+/**
+ * Polygon clipping backends.
+ */
+enum Clipper {
+    //! Float edge tracing (ConvexPolygon::booleanDifference)
+    TRACE_CLIPPER,
+
+    //! Fixed point half-plane clipping (fixedDifference)
+    FIXED_CLIPPER
+};
+
+/**
+ * Subtract a hole from a convex polygon using fixed point arithmetic.
+ *
+ * The coordinates are snapped to a 1/16384 unit grid and the polygon is
+ * cut along each edge of the hole in turn: the part on the outer side of
+ * the edge is emitted as a piece and the part on the inner side is carried
+ * over to the next edge. All side tests are exact 64 bit integer cross
+ * products, so unlike the tracer this never produces an invalid polygon.
+ * Since both operands are convex, this is what a Vatti style scanbeam
+ * clipper boils down to, without the general machinery.
+ *
+ * If the polygon does not overlap the hole, it is added unchanged.
+ * Pieces are snapped to the grid and pieces smaller than 1/16384 square
+ * units are dropped. Coordinates must be within 65536 units of the origin.
+ *
+ * @param polygon the polygon to cut
+ * @param hole the hole polygon
+ * @param list the vector to which the new polygons should be added
+ * @return always true
+ */
+bool fixedDifference(const ConvexPolygon &polygon, const ConvexPolygon &hole, std::vector<ConvexPolygon> &list);
+
+/**
+ * Subtract a hole from a convex polygon using the given backend.
+ *
+ * @param clipper the clipping backend to use
+ * @param polygon the polygon to cut
+ * @param hole the hole polygon
+ * @param list the vector to which the new polygons should be added
+ * @return false if the operation failed and the polygon was added unchanged
+ */
+inline bool difference(Clipper clipper, const ConvexPolygon &polygon, const ConvexPolygon &hole, std::vector<ConvexPolygon> &list)
+{
+    if(clipper == FIXED_CLIPPER)
+        return fixedDifference(polygon, hole, list);
+    return polygon.booleanDifference(hole, list);
+}
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include "compact.h"
+
+namespace terrain {
+
+namespace {
+    // Relative tolerance for treating a vertex as collinear
+    const float COLLINEAR_EPSILON = 1e-5f;
+
+    float cross(const Point &a, const Point &b)
+    {
+        return a.x * b.y - a.y * b.x;
+    }
+
+    float area(const Points &points)
+    {
+        float a = 0;
+        for(unsigned int i=0;i<points.size();++i)
+            a += cross(points[i], points[(i+1) % points.size()]);
+        return a * 0.5f;
+    }
+
+    // An edge key. Points are compared exactly: only edges whose
+    // endpoints are bit for bit the same are considered shared.
+    typedef std::tuple<float, float, float, float> EdgeKey;
+
+    EdgeKey edgeKey(const Point &a, const Point &b)
+    {
+        return EdgeKey(a.x, a.y, b.x, b.y);
+    }
+
+    typedef std::map<EdgeKey, unsigned int> EdgeMap;
+
+    void addEdges(EdgeMap &edges, const Points &poly, unsigned int index)
+    {
+        for(unsigned int i=0;i<poly.size();++i)
+            edges[edgeKey(poly[i], poly[(i+1) % poly.size()])] = index;
+    }
+
+    void removeEdges(EdgeMap &edges, const Points &poly)
+    {
+        for(unsigned int i=0;i<poly.size();++i)
+            edges.erase(edgeKey(poly[i], poly[(i+1) % poly.size()]));
+    }
+
+    // A vertex key. Like edges, vertices are compared exactly.
+    typedef std::tuple<float, float> VertexKey;
+
+    typedef std::map<VertexKey, unsigned int> VertexCount;
+
+    /*
+     * Check if the corner prev-cur-next turns left.
+     *
+     * Straight corners are allowed, but not ones that fold back.
+     */
+    bool isConvexCorner(const Point &prev, const Point &cur, const Point &next)
+    {
+        const Point e1 = cur - prev;
+        const Point e2 = next - cur;
+        const float c = cross(e1, e2);
+        return c > 0 || (c == 0 && glm::dot(e1, e2) > 0);
+    }
+
+    /*
+     * Merge polygons P and Q along their shared edge.
+     *
+     * P has the edge (a,b) starting at index pi, Q has the edge (b,a)
+     * starting at index qi. Returns false if the merged polygon
+     * would not be convex. All vertices are kept, since neighbouring
+     * polygons may still share edges ending at them.
+     */
+    bool merge(const Points &p, unsigned int pi, const Points &q, unsigned int qi, Points &merged)
+    {
+        const unsigned int pn = p.size();
+        const unsigned int qn = q.size();
+
+        // Only the corners at a and b change. The rest are
+        // the corners of P and Q, which are already convex.
+        const Point &a = p[pi];
+        const Point &b = p[(pi + 1) % pn];
+        if(!isConvexCorner(p[(pi + pn - 1) % pn], a, q[(qi + 2) % qn]) ||
+           !isConvexCorner(q[(qi + qn - 1) % qn], b, p[(pi + 2) % pn]))
+            return false;
+
+        // Outline: P from b around to a, then Q from after a to before b
+        merged.clear();
+        merged.reserve(pn + qn - 2);
+        for(unsigned int i=0;i<pn;++i)
+            merged.push_back(p[(pi + 1 + i) % pn]);
+        for(unsigned int i=2;i<qn;++i)
+            merged.push_back(q[(qi + i) % qn]);
+
+        return true;
+    }
+
+    /*
+     * Remove vertices in the middle of straight edges.
+     *
+     * A vertex used by some other polygon is kept even if it is
+     * collinear, or that polygon's edge would end in the middle of
+     * this one's, leaving a T-junction.
+     */
+    void removeCollinear(Points &poly, const VertexCount &uses)
+    {
+        Points kept;
+        kept.reserve(poly.size());
+        const unsigned int n = poly.size();
+        for(unsigned int i=0;i<n;++i) {
+            const Point &prev = kept.empty() ? poly[n - 1] : kept.back();
+            const Point &cur = poly[i];
+            const Point &next = poly[(i + 1) % n];
+            const Point e1 = cur - prev;
+            const Point e2 = next - cur;
+
+            const float c = cross(e1, e2);
+            const float tolerance = COLLINEAR_EPSILON * glm::length(e1) * glm::length(e2);
+            const bool collinear = c >= 0 && c <= tolerance && glm::dot(e1, e2) > 0;
+            if(!collinear || uses.at(VertexKey(cur.x, cur.y)) > 1)
+                kept.push_back(cur);
+        }
+
+        if(kept.size() >= 3)
+            poly.swap(kept);
+    }
+}
+
+std::vector<ConvexPolygon> compactPolygons(const std::vector<ConvexPolygon> &polygons, float minarea)
+{
+    // Drop slivers
+    std::vector<Points> polys;
+    polys.reserve(polygons.size());
+    for(const ConvexPolygon &poly : polygons) {
+        if(area(poly.vertices()) >= minarea)
+            polys.push_back(poly.vertices());
+    }
+
+    std::vector<bool> alive(polys.size(), true);
+
+    EdgeMap edges;
+    for(unsigned int i=0;i<polys.size();++i)
+        addEdges(edges, polys[i], i);
+
+    // Greedily merge each polygon with its neighbours for as
+    // long as the result stays convex
+    Points merged;
+    for(unsigned int pindex=0;pindex<polys.size();++pindex) {
+        if(!alive[pindex])
+            continue;
+
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            const Points &p = polys[pindex];
+            for(unsigned int pi=0;pi<p.size();++pi) {
+                const Point &a = p[pi];
+                const Point &b = p[(pi+1) % p.size()];
+
+                auto neighbour = edges.find(edgeKey(b, a));
+                if(neighbour == edges.end() || neighbour->second == pindex)
+                    continue;
+
+                const unsigned int qindex = neighbour->second;
+                const Points &q = polys[qindex];
+                unsigned int qi = 0;
+                while(q[qi] != b)
+                    ++qi;
+
+                if(merge(p, pi, q, qi, merged)) {
+                    removeEdges(edges, polys[pindex]);
+                    removeEdges(edges, polys[qindex]);
+                    polys[pindex].swap(merged);
+                    polys[qindex].clear();
+                    alive[qindex] = false;
+                    addEdges(edges, polys[pindex], pindex);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Clean up the straight edges only once merging is done. Removing
+    // a vertex earlier could make an edge stop matching its neighbour.
+    VertexCount uses;
+    for(unsigned int i=0;i<polys.size();++i) {
+        if(alive[i]) {
+            for(const Point &v : polys[i])
+                ++uses[VertexKey(v.x, v.y)];
+        }
+    }
+
+    std::vector<ConvexPolygon> result;
+    for(unsigned int i=0;i<polys.size();++i) {
+        if(alive[i]) {
+            removeCollinear(polys[i], uses);
+            result.push_back(ConvexPolygon(polys[i]));
+        }
+    }
+    return result;
+}
+
+}
+
@@ -0,0 +1,47 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_COMPACT_H
+#define LUOLA_TERRAIN_COMPACT_H
+
+#include "polygon.h"
+
+namespace terrain {
+
+/**
+ * Merge convex polygons back into larger ones.
+ *
+ * Repeated boolean differences split terrain into ever smaller pieces.
+ * This finds polygons that share a whole edge and merges them when the
+ * result is still convex, i.e. removes the inessential diagonals the same
+ * way Hertel-Mehlhorn partitioning does. Once merging is done, vertices
+ * left in the middle of a straight edge are removed unless another polygon
+ * still uses them. Slivers smaller than the given area are dropped
+ * altogether.
+ *
+ * The result is deterministic.
+ *
+ * @param polygons the polygons to compact
+ * @param minarea polygons smaller than this are removed
+ * @return compacted polygon list
+ */
+std::vector<ConvexPolygon> compactPolygons(const std::vector<ConvexPolygon> &polygons, float minarea);
+
+}
+
+#endif
+
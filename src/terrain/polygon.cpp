@@ -23,6 +23,11 @@ using std::endl;
 
 #include <stack>
 #include <queue>
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include "polygon.h"
 #include "algorithm.h"
@@ -56,7 +61,7 @@ void ConvexPolygon::make(const Points &points, std::vector<ConvexPolygon> &polys
 #endif
 }
 
-bool ConvexPolygon::circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const
+bool PolygonView::circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const
 {
     for(int i=0;i<vertexCount();++i) {
         // Check if the circle is moving away from the edge
@@ -90,9 +95,9 @@ bool ConvexPolygon::circleCollision(const Point &p, float r, const glm::vec2 &v,
 
         float root = b*b - a*c;
         if(root >= 0) {
-            float t = (-b - glm::sqrt(root)) / a;
+            float t = (b - glm::sqrt(root)) / a;
             if(t >= 0 && t <= 1) {
-                cp = p - v * t;
+                cp = p + v * t;
                 normal = n;
                 return true;
             }
@@ -105,7 +110,7 @@ bool ConvexPolygon::circleCollision(const Point &p, float r, const glm::vec2 &v,
 
 // Separating Axis Theorem tests
 namespace {
-    void project_polygon(const ConvexPolygon &polygon, const glm::vec2 &axis, float &min, float &max)
+    void project_polygon(const PolygonView &polygon, const glm::vec2 &axis, float &min, float &max)
     {
         min = max = glm::dot(polygon.vertex(0), axis);
         for(int i=1;i<polygon.vertexCount();++i) {
@@ -118,7 +123,7 @@ namespace {
     }
 
     // Project vertices of p1 and p2 onto axis and return true if they intersect
-    bool test_projection(const ConvexPolygon &p1, const ConvexPolygon &p2, const glm::vec2 &axis)
+    bool test_projection(const PolygonView &p1, const PolygonView &p2, const glm::vec2 &axis)
     {
         float p1min, p1max, p2min, p2max;
         project_polygon(p1, axis, p1min, p1max);
@@ -126,9 +131,60 @@ namespace {
 
         return p1min < p2max && p1max > p2min;
     }
+
+    // Check if any edge normal of the axes polygon separates p1 and p2
+    bool separated(const PolygonView &axes, const PolygonView &p1, const PolygonView &p2)
+    {
+        for(int i=0;i<axes.vertexCount();++i) {
+            if(!test_projection(p1, p2, axes.normal(i)))
+                return true;
+        }
+        return false;
+    }
+
+#ifdef __SSE__
+    // Project the vertices of the polygon onto four axes at once.
+    // Each lane of min and max holds the extents along one axis.
+    void project_polygon4(const PolygonView &polygon, const __m128 &nx, const __m128 &ny, __m128 &min, __m128 &max)
+    {
+        const Point &v0 = polygon.vertex(0);
+        min = max = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v0.x), nx), _mm_mul_ps(_mm_set1_ps(v0.y), ny));
+        for(int i=1;i<polygon.vertexCount();++i) {
+            const Point &v = polygon.vertex(i);
+            const __m128 f = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.x), nx), _mm_mul_ps(_mm_set1_ps(v.y), ny));
+            min = _mm_min_ps(min, f);
+            max = _mm_max_ps(max, f);
+        }
+    }
+
+    bool separated4(const PolygonView &axes, const PolygonView &p1, const PolygonView &p2)
+    {
+        const int n = axes.vertexCount();
+        for(int i=0;i<n;i+=4) {
+            // The last group is padded by repeating the last axis
+            float x[4], y[4];
+            for(int j=0;j<4;++j) {
+                const glm::vec2 &axis = axes.normal(std::min(i + j, n - 1));
+                x[j] = axis.x;
+                y[j] = axis.y;
+            }
+            const __m128 nx = _mm_loadu_ps(x);
+            const __m128 ny = _mm_loadu_ps(y);
+
+            __m128 p1min, p1max, p2min, p2max;
+            project_polygon4(p1, nx, ny, p1min, p1max);
+            project_polygon4(p2, nx, ny, p2min, p2max);
+
+            const __m128 overlap = _mm_and_ps(_mm_cmplt_ps(p1min, p2max), _mm_cmpgt_ps(p1max, p2min));
+            if(_mm_movemask_ps(overlap) != 0xf)
+                return true;
+        }
+        return false;
+    }
+#endif
 }
 
-bool ConvexPolygon::hasPoint(const Point &point) const
+bool PolygonView::hasPoint(const Point &point) const
 {
     for(int i=0;i<vertexCount();++i) {
         glm::vec2 side = vertex(i+1) - vertex(i);
@@ -140,24 +196,32 @@ bool ConvexPolygon::hasPoint(const Point &point) const
     return true;
 }
 
-bool ConvexPolygon::overlaps(const ConvexPolygon &polygon) const
+bool PolygonView::overlaps(const PolygonView &polygon) const
 {
+#ifdef __SSE__
     // First a simple bound check
     if(!bounds().overlaps(polygon.bounds()))
         return false;
 
     // Overlap check using separating axis theorem
-    for(const glm::vec2 &normal : m_normals) {
-        if(!test_projection(*this, polygon, normal))
-            return false;
-    }
-    return true;
+    return !separated4(*this, *this, polygon) && !separated4(polygon, *this, polygon);
+#else
+    return overlapsScalar(polygon);
+#endif
 }
 
-bool ConvexPolygon::envelopes(const ConvexPolygon &polygon) const
+bool PolygonView::overlapsScalar(const PolygonView &polygon) const
 {
-    for(const Point &p : polygon.vertices())
-        if(!hasPoint(p))
+    if(!bounds().overlaps(polygon.bounds()))
+        return false;
+
+    return !separated(*this, *this, polygon) && !separated(polygon, *this, polygon);
+}
+
+bool PolygonView::envelopes(const PolygonView &polygon) const
+{
+    for(int i=0;i<polygon.vertexCount();++i)
+        if(!hasPoint(polygon.vertex(i)))
             return false;
     return true;
 }
@@ -290,19 +354,29 @@ namespace {
 
 }
 
-void ConvexPolygon::booleanDifference(const ConvexPolygon &hole, std::vector<ConvexPolygon> &list) const
+bool ConvexPolygon::booleanDifference(const ConvexPolygon &hole, std::vector<ConvexPolygon> &list) const
 {
     // Special case: this polygon is entirely swallowed by the hole
     if(hole.envelopes(*this))
-        return;
+        return true;
 
     // Special case: the hole is entirely inside this polygon
     if(envelopes(hole)) {
         Points p1, p2;
         splitPolygon(*this, hole, p1, p2);
-        ConvexPolygon::make(p1, list);
-        ConvexPolygon::make(p2, list);
-        return;
+        const unsigned int oldsize = list.size();
+        try {
+            ConvexPolygon::make(p1, list);
+            ConvexPolygon::make(p2, list);
+        } catch(const algorithm::GeometryException &e) {
+#ifndef NDEBUG
+            cerr << "booleanDifference error: " << e.what() << " (split rolled back)\n";
+#endif
+            list.resize(oldsize);
+            list.push_back(*this);
+            return false;
+        }
+        return true;
     }
 
     // Common case: hole intersects with this polygon.
@@ -393,15 +467,21 @@ void ConvexPolygon::booleanDifference(const ConvexPolygon &hole, std::vector<Con
                 while(changes-->0)
                     list.pop_back();
                 list.push_back(*this);
-                return;
+                return false;
             }
         }
         poly.clear();
         queue.pop();
     }
+    return true;
+}
+
+ConvexPolygon PolygonView::toPolygon() const
+{
+    return ConvexPolygon(Points(m_points, m_points + m_count));
 }
 
-void ConvexPolygon::toTriangles(Points &points) const
+void PolygonView::toTriangles(Points &points) const
 {
 #if 0
     // Debugging: triangles with GL_LINES
@@ -414,7 +494,7 @@ void ConvexPolygon::toTriangles(Points &points) const
     points.push_back(m_points[2]);
     points.push_back(m_points[0]);
 
-    for(unsigned int i=2;i<m_points.size();++i) {
+    for(int i=2;i<m_count;++i) {
         points.push_back(m_points[0]);
         points.push_back(m_points[i]);
         points.push_back(m_points[i]);
@@ -422,7 +502,7 @@ void ConvexPolygon::toTriangles(Points &points) const
     }
 #else
     // Debugging: Polygon outline with GL_LINES
-    for(unsigned int i=1;i<m_points.size();++i) {
+    for(int i=1;i<m_count;++i) {
         points.push_back(m_points[i-1]);
         points.push_back(m_points[i]);
 
@@ -434,14 +514,14 @@ void ConvexPolygon::toTriangles(Points &points) const
         points.push_back(np + m_normals[i-1] * Point(0.2, 0.2));
 #endif
     }
-    points.push_back(m_points.back());
+    points.push_back(m_points[m_count-1]);
     points.push_back(m_points[0]);
 
 #if 0
-    Point halfp = (m_points.back() - m_points[0]) * Point(0.5, 0.5);
+    Point halfp = (m_points[m_count-1] - m_points[0]) * Point(0.5, 0.5);
     Point np = m_points[0] + halfp;
     points.push_back(np);
-    points.push_back(np + m_normals.back() * Point(0.2, 0.2));
+    points.push_back(np + m_normals[m_count-1] * Point(0.2, 0.2));
 #endif
 
 #endif
@@ -24,6 +24,141 @@
 
 namespace terrain {
 
+ class ConvexPolygon;
+
+ /**
+  * A read only view of a convex polygon.
+  *
+  * The vertices and edge normals are not owned by the view. They can
+  * belong to a ConvexPolygon or be part of a PolygonSet, so the same
+  * algorithms work on both. The view is valid only as long as the
+  * storage it points to is not modified.
+  */
+ class PolygonView {
+ public:
+     /**
+      * Construct a view of vertices stored elsewhere.
+      *
+      * @param points pointer to the first vertex
+      * @param normals pointer to the first edge normal
+      * @param count number of vertices (and normals)
+      * @param bounds the polygon's bounding box
+      */
+     PolygonView(const Point *points, const glm::vec2 *normals, int count, const BRect &bounds)
+         : m_points(points), m_normals(normals), m_count(count), m_bounds(&bounds)
+     { }
+
+     /**
+      * Construct a view of a convex polygon.
+      *
+      * @param polygon the polygon
+      */
+     PolygonView(const ConvexPolygon &polygon);
+
+     /**
+      * Check for a collision with a moving circle.
+      *
+      * See ConvexPolygon::circleCollision()
+      */
+     bool circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const;
+
+     /**
+      * Check if the given point is inside the polygon.
+      *
+      * @param point point coordinates
+      * @return true if point is inside the polygon
+      */
+     bool hasPoint(const Point &point) const;
+
+     /**
+      * Check if the given polygon is completely inside this one.
+      *
+      * @param polygon the polygon to test
+      * @return true if polygon is inside this one.
+      */
+     bool envelopes(const PolygonView &polygon) const;
+
+     /**
+      * Check if this polygon overlaps with the given polygon.
+      *
+      * The edge normals of both polygons are tested as separating axes.
+      * When SSE is available, four axes are tested at a time.
+      *
+      * @param polygon the polygon to test
+      * @return true if polygons overlap
+      */
+     bool overlaps(const PolygonView &polygon) const;
+
+     /**
+      * Scalar reference implementation of overlaps().
+      *
+      * This gives exactly the same results as overlaps(), but does
+      * not use SIMD instructions.
+      *
+      * @param polygon the polygon to test
+      * @return true if polygons overlap
+      */
+     bool overlapsScalar(const PolygonView &polygon) const;
+
+     /**
+      * Get the number of vertices in this polygon.
+      *
+      * @return vertex count
+      */
+     int vertexCount() const { return m_count; }
+
+     /**
+      * Get the vertex at the given index.
+      *
+      * Index must be in range [-1..vertexCount()]. As with
+      * ConvexPolygon::vertex(), the indices wrap around.
+      *
+      * @param i vertex index
+      * @return vertex
+      */
+     const Point &vertex(int i) const {
+         assert(i >= -1 && i <= m_count);
+         if(i<0)
+             return m_points[m_count-1];
+         if(i<m_count)
+             return m_points[i];
+         return m_points[0];
+     }
+
+     /**
+      * Get the normal of the edge starting at the given vertex.
+      *
+      * @param i vertex index in range [0..vertexCount()-1]
+      * @return edge normal
+      */
+     const glm::vec2 &normal(int i) const { return m_normals[i]; }
+
+     /**
+      * Get the polygon bounding box
+      */
+     const BRect &bounds() const { return *m_bounds; }
+
+     /**
+      * Make a standalone copy of this polygon.
+      *
+      * @return new polygon
+      */
+     ConvexPolygon toPolygon() const;
+
+     /**
+      * Triangulate this polygon.
+      *
+      * @param points the vector to which the vertices will be added
+      */
+     void toTriangles(Points &points) const;
+
+ private:
+     const Point *m_points;
+     const glm::vec2 *m_normals;
+     int m_count;
+     const BRect *m_bounds;
+ };
+
  /**
   * A convex polygon. The terrain is made up of these.
   */
@@ -61,7 +196,9 @@ namespace terrain {
       * @param normal normal of the colliding edge
       * @return true if collision happens
       */
-     bool circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const;
+     bool circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const {
+         return PolygonView(*this).circleCollision(p, r, v, cp, normal);
+     }
 
      /**
       * Check if the given point is inside the polygon.
@@ -69,7 +206,7 @@ namespace terrain {
       * @param point point coordinates
       * @return true if point is inside the polygon
       */
-     bool hasPoint(const Point &point) const;
+     bool hasPoint(const Point &point) const { return PolygonView(*this).hasPoint(point); }
 
      /**
       * Check if the given polygon is completely inside this one.
@@ -77,7 +214,7 @@ namespace terrain {
       * @param polygon the polygon to test
       * @return true if polygon is inside this one.
       */
-     bool envelopes(const ConvexPolygon &polygon) const;
+     bool envelopes(const PolygonView &polygon) const { return PolygonView(*this).envelopes(polygon); }
 
      /**
       * Check if this polygon overlaps with the given polygon.
@@ -87,7 +224,7 @@ namespace terrain {
       * @param polygon the polygon to test
       * @return true if polygons overlap
       */
-     bool overlaps(const ConvexPolygon &polygon) const;
+     bool overlaps(const PolygonView &polygon) const { return PolygonView(*this).overlaps(polygon); }
 
      /**
       * Apply a boolean difference operation to this polygon.
@@ -95,11 +232,15 @@ namespace terrain {
       * The newly generated polygons will be added to the provided list.
       * If this polygon is enveloped totally by the hole, no polygons will
       * be added.
+      *
+      * If the operation produces an invalid polygon, it is rolled back
+      * and this polygon is added to the list unchanged.
       * 
       * @param hole the polygon that defines the "hole" to make.
       * @param list the vector to which the new polygons should be added
+      * @return false if the operation was rolled back
       */
-     void booleanDifference(const ConvexPolygon &hole, std::vector<ConvexPolygon> &list) const;
+     bool booleanDifference(const ConvexPolygon &hole, std::vector<ConvexPolygon> &list) const;
 
      /**
       * Get the number of vertices in this polygon.
@@ -153,7 +294,7 @@ namespace terrain {
       *
       * @param points the vector to which the vertices will be added
       */
-     void toTriangles(Points &points) const;
+     void toTriangles(Points &points) const { PolygonView(*this).toTriangles(points); }
  
  private:
      Points m_points;
@@ -161,6 +302,11 @@ namespace terrain {
      BRect m_bounds;
  };
 
+ inline PolygonView::PolygonView(const ConvexPolygon &polygon)
+     : m_points(polygon.vertices().data()), m_normals(polygon.normals().data()),
+       m_count(polygon.vertexCount()), m_bounds(&polygon.bounds())
+ { }
+
 }
 
 #endif
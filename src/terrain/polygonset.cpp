@@ -0,0 +1,131 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+
+#include "polygonset.h"
+
+namespace terrain {
+
+PolygonSet::PolygonSet()
+    : m_unused(0)
+{
+}
+
+PolygonSet::PolygonSet(const std::vector<ConvexPolygon> &polygons)
+    : m_unused(0)
+{
+    unsigned int vertices = 0;
+    for(const ConvexPolygon &p : polygons)
+        vertices += p.vertexCount();
+
+    m_points.reserve(vertices);
+    m_normals.reserve(vertices);
+    m_ranges.reserve(polygons.size());
+    m_bounds.reserve(polygons.size());
+
+    for(const ConvexPolygon &p : polygons)
+        append(p);
+}
+
+PolygonSet::Range PolygonSet::store(const ConvexPolygon &polygon)
+{
+    Range r { uint32_t(m_points.size()), uint32_t(polygon.vertexCount()) };
+    m_points.insert(m_points.end(), polygon.vertices().begin(), polygon.vertices().end());
+    m_normals.insert(m_normals.end(), polygon.normals().begin(), polygon.normals().end());
+    return r;
+}
+
+void PolygonSet::replace(unsigned int i, const ConvexPolygon &polygon)
+{
+    Range &r = m_ranges[i];
+    const uint32_t count = polygon.vertexCount();
+
+    if(count <= r.count) {
+        // Fits in the old place
+        std::copy(polygon.vertices().begin(), polygon.vertices().end(), m_points.begin() + r.first);
+        std::copy(polygon.normals().begin(), polygon.normals().end(), m_normals.begin() + r.first);
+        m_unused += r.count - count;
+        r.count = count;
+    } else {
+        m_unused += r.count;
+        r = store(polygon);
+    }
+    m_bounds[i] = polygon.bounds();
+
+    compactIfNeeded();
+}
+
+void PolygonSet::append(const ConvexPolygon &polygon)
+{
+    m_ranges.push_back(store(polygon));
+    m_bounds.push_back(polygon.bounds());
+}
+
+void PolygonSet::remove(unsigned int i)
+{
+    m_unused += m_ranges[i].count;
+
+    const unsigned int last = m_ranges.size() - 1;
+    if(i != last) {
+        m_ranges[i] = m_ranges[last];
+        m_bounds[i] = m_bounds[last];
+    }
+    m_ranges.pop_back();
+    m_bounds.pop_back();
+
+    if(m_ranges.empty()) {
+        m_points.clear();
+        m_normals.clear();
+        m_unused = 0;
+    } else {
+        compactIfNeeded();
+    }
+}
+
+void PolygonSet::compactIfNeeded()
+{
+    if(m_unused * 2 <= m_points.size())
+        return;
+
+    std::vector<Point> points;
+    std::vector<glm::vec2> normals;
+    points.reserve(m_points.size() - m_unused);
+    normals.reserve(m_points.size() - m_unused);
+
+    for(Range &r : m_ranges) {
+        const uint32_t first = points.size();
+        points.insert(points.end(), m_points.begin() + r.first, m_points.begin() + r.first + r.count);
+        normals.insert(normals.end(), m_normals.begin() + r.first, m_normals.begin() + r.first + r.count);
+        r.first = first;
+    }
+
+    m_points.swap(points);
+    m_normals.swap(normals);
+    m_unused = 0;
+}
+
+std::vector<ConvexPolygon> PolygonSet::toVector() const
+{
+    std::vector<ConvexPolygon> polygons;
+    polygons.reserve(size());
+    for(unsigned int i=0;i<size();++i)
+        polygons.push_back((*this)[i].toPolygon());
+    return polygons;
+}
+
+}
@@ -0,0 +1,138 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_POLYGONSET_H
+#define LUOLA_TERRAIN_POLYGONSET_H
+
+#include <cstdint>
+
+#include "polygon.h"
+
+namespace terrain {
+
+/**
+ * A list of convex polygons in flat storage.
+ *
+ * The vertices and edge normals of all the polygons are kept in two
+ * contiguous arrays, and each polygon is just an offset and a vertex
+ * count into them. The bounding boxes are kept in an array of their
+ * own, so they can be scanned without touching the vertex data.
+ * Polygons are accessed through PolygonViews.
+ *
+ * Replacing a polygon with a bigger one, or removing one, leaves unused
+ * space in the arrays. When more than half of the storage is unused,
+ * it is compacted. Any modification invalidates existing views.
+ */
+class PolygonSet {
+public:
+    PolygonSet();
+
+    /**
+     * Construct a set from a list of polygons.
+     *
+     * @param polygons the polygons to copy
+     */
+    explicit PolygonSet(const std::vector<ConvexPolygon> &polygons);
+
+    /**
+     * Get the number of polygons in the set.
+     *
+     * @return polygon count
+     */
+    unsigned int size() const { return m_ranges.size(); }
+
+    /**
+     * Check if the set is empty.
+     *
+     * @return true if there are no polygons
+     */
+    bool empty() const { return m_ranges.empty(); }
+
+    /**
+     * Get a view of a polygon.
+     *
+     * @param i polygon index
+     * @return polygon view
+     */
+    PolygonView operator[](unsigned int i) const {
+        const Range &r = m_ranges[i];
+        return PolygonView(m_points.data() + r.first, m_normals.data() + r.first, r.count, m_bounds[i]);
+    }
+
+    /**
+     * Get the bounding boxes of all the polygons.
+     *
+     * The box of polygon i is at index i.
+     *
+     * @return bounding box array
+     */
+    const std::vector<BRect> &bounds() const { return m_bounds; }
+
+    /**
+     * Replace a polygon.
+     *
+     * @param i index of the polygon to replace
+     * @param polygon the new polygon
+     */
+    void replace(unsigned int i, const ConvexPolygon &polygon);
+
+    /**
+     * Add a polygon to the end of the list.
+     *
+     * @param polygon the polygon to add
+     */
+    void append(const ConvexPolygon &polygon);
+
+    /**
+     * Remove a polygon.
+     *
+     * The last polygon is moved to its place.
+     *
+     * @param i index of the polygon to remove
+     */
+    void remove(unsigned int i);
+
+    /**
+     * Copy the polygons into a list of standalone polygons.
+     *
+     * @return list of polygons
+     */
+    std::vector<ConvexPolygon> toVector() const;
+
+private:
+    struct Range {
+        uint32_t first, count;
+    };
+
+    // Store the vertices and normals of the polygon at the end of the arrays
+    Range store(const ConvexPolygon &polygon);
+
+    // Repack the arrays in polygon order if enough space has gone unused
+    void compactIfNeeded();
+
+    std::vector<Point> m_points;
+    std::vector<glm::vec2> m_normals;
+    std::vector<Range> m_ranges;
+    std::vector<BRect> m_bounds;
+
+    // Number of unused entries in m_points and m_normals
+    unsigned int m_unused;
+};
+
+}
+
+#endif
@@ -16,109 +16,326 @@
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <iostream>
-#include <GL/glew.h>
+#include <algorithm>
+#include <memory>
 #include <glm/gtx/norm.hpp>
 
 #include "terrain.h"
-#include "../res/shader.h"
+#include "compact.h"
+#include "../res/resources.h"
 
 namespace terrain {
 
+namespace {
+    // A terrain is considered fragmented when it has this many times
+    // the original number of polygons (and at least MIN_FRAGMENTS.)
+    const unsigned int FRAGMENTATION = 2;
+    const unsigned int MIN_FRAGMENTS = 32;
+}
+
 Terrain::Terrain(const std::vector<ConvexPolygon> &polygons)
-    : m_polygons(polygons), m_dirty(true)
+    : m_polygons(polygons), m_buffer(nullptr), m_slots(polygons.size()),
+      m_compacting(false), m_cutting(false), m_basecount(polygons.size()), m_clipper(TRACE_CLIPPER), m_dirty(true)
 {
-
-    glGenVertexArrays(1, &m_vao);
-    glGenBuffers(1, &m_vbuffer);
-
-    // TODO set these properly
-    m_program = resource::get<resource::Program>("core.shader.terrain")->id();
-    m_uniform_mvp = glGetUniformLocation(m_program, "MVP");
+    for(unsigned int i=0;i<m_polygons.size();++i)
+        m_proxies.push_back(m_tree.insert(m_polygons[i].bounds(), i));
 }
 
 Terrain::~Terrain()
 {
-    glDeleteVertexArrays(1, &m_vao);
-    glDeleteBuffers(1, &m_vbuffer);
+    setBuffer(nullptr);
 }
 
 bool Terrain::hasPoint(const Point &p) const
 {
-    for(const ConvexPolygon &poly : m_polygons) {
-        if(poly.hasPoint(p))
-            return true;
-    }
-    return false;
+    bool found = false;
+    m_tree.query(BRect(p, p), [this, &p, &found](unsigned int i) {
+        if(!found && m_polygons[i].hasPoint(p))
+            found = true;
+    });
+    return found;
 }
 
 bool Terrain::circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const
 {
     float nearest = 9999.0f;
+    unsigned int nearestpoly = 0;
 
     Point colp;
     glm::vec2 colnormal;
-    for(const ConvexPolygon &poly : m_polygons) {
-        if(poly.circleCollision(p, r, v, colp, colnormal)) {
+    m_tree.query(sweptCircleBounds(p, r, v), [&](unsigned int i) {
+        if(m_polygons[i].circleCollision(p, r, v, colp, colnormal)) {
             float dist = glm::distance2(colp, p);
-            if(dist < nearest) {
+            // Ties are resolved by polygon index, so the result does
+            // not depend on the shape of the tree.
+            if(dist < nearest || (dist == nearest && i < nearestpoly)) {
                 nearest = dist;
+                nearestpoly = i;
                 cp = colp;
                 normal = colnormal;
             }
         }
-    }
+    });
     return nearest < 9999.0f;
 }
 
 bool Terrain::nibble(const ConvexPolygon &hole)
 {
-    // First, check that there are overlaps in the first place
-    int found = -1;
-    for(unsigned int i=0;i<m_polygons.size();++i) {
-        if(m_polygons[i].overlaps(hole)) {
-            found = i;
-            break;
+    return nibble(std::vector<ConvexPolygon>(1, hole));
+}
+
+bool Terrain::nibble(const std::vector<ConvexPolygon> &holes)
+{
+    // Keep the holes in order
+    if(m_cutting)
+        finishNibble();
+
+    std::vector<Hit> hits;
+    std::vector<unsigned int> indices;
+    std::vector<ConvexPolygon> polygons;
+    findHits(holes, hits, indices, polygons);
+
+    if(hits.empty())
+        return false;
+
+    if(m_compacting)
+        m_compactionholes.insert(m_compactionholes.end(), holes.begin(), holes.end());
+
+    applyCut(indices, cutPolygons(m_clipper, polygons, hits, holes));
+
+    return true;
+}
+
+bool Terrain::startNibble(const std::vector<ConvexPolygon> &holes)
+{
+    if(m_cutting)
+        finishNibble();
+
+    // The worker gets its own copies of everything it needs
+    std::shared_ptr<std::vector<Hit>> hits(new std::vector<Hit>());
+    std::shared_ptr<std::vector<ConvexPolygon>> polygons(new std::vector<ConvexPolygon>());
+    findHits(holes, *hits, m_cutpolygons, *polygons);
+
+    if(hits->empty())
+        return false;
+
+    std::shared_ptr<std::vector<ConvexPolygon>> holecopy(new std::vector<ConvexPolygon>(holes));
+    const Clipper clipper = m_clipper;
+    m_cut = ThreadPool::runBackground([clipper, polygons, hits, holecopy]() -> boost::any {
+        return std::shared_ptr<std::vector<std::vector<ConvexPolygon>>>(
+            new std::vector<std::vector<ConvexPolygon>>(cutPolygons(clipper, *polygons, *hits, *holecopy)));
+    });
+    m_cutholes = holes;
+    m_cutting = true;
+
+    return true;
+}
+
+void Terrain::finishNibble()
+{
+    assert(m_cutting);
+
+    std::shared_ptr<std::vector<std::vector<ConvexPolygon>>> pieces =
+        boost::any_cast<std::shared_ptr<std::vector<std::vector<ConvexPolygon>>>>(m_cut.get());
+    m_cutting = false;
+
+    applyCut(m_cutpolygons, *pieces);
+    m_cutpolygons.clear();
+
+    if(m_compacting)
+        m_compactionholes.insert(m_compactionholes.end(), m_cutholes.begin(), m_cutholes.end());
+    m_cutholes.clear();
+}
+
+void Terrain::findHits(const std::vector<ConvexPolygon> &holes, std::vector<Hit> &hits,
+    std::vector<unsigned int> &indices, std::vector<ConvexPolygon> &polygons) const
+{
+    hits.clear();
+    indices.clear();
+    polygons.clear();
+
+    for(unsigned int h=0;h<holes.size();++h) {
+        const ConvexPolygon &hole = holes[h];
+        m_tree.query(hole.bounds(), [this, &hole, &hits, h](unsigned int i) {
+            if(m_polygons[i].overlaps(hole))
+                hits.push_back(Hit { i, h });
+        });
+    }
+
+    std::sort(hits.begin(), hits.end());
+
+    for(Hit &hit : hits) {
+        if(indices.empty() || indices.back() != hit.polygon) {
+            indices.push_back(hit.polygon);
+            polygons.push_back(m_polygons[hit.polygon].toPolygon());
         }
+        hit.polygon = indices.size() - 1;
     }
+}
 
-    if(found>=0) {
-        // If overlapping polygons were found, generate a new list.
-        // A single polygon can be removed altogether or may be split
-        // into multiple smaller polygons.
+std::vector<std::vector<ConvexPolygon>> Terrain::cutPolygons(
+    Clipper clipper,
+    const std::vector<ConvexPolygon> &polygons,
+    const std::vector<Hit> &hits,
+    const std::vector<ConvexPolygon> &holes)
+{
+    std::vector<std::vector<ConvexPolygon>> result(polygons.size());
+    std::vector<ConvexPolygon> cut;
 
-        std::vector<ConvexPolygon> newpolys;
+    unsigned int begin = 0;
+    while(begin<hits.size()) {
+        const unsigned int i = hits[begin].polygon;
+        unsigned int end = begin + 1;
+        while(end<hits.size() && hits[end].polygon == i)
+            ++end;
 
-        // We already know that polygons [0..found) don't overlap
-        for(int i=0;i<found;++i)
-            newpolys.push_back(std::move(m_polygons[i]));
+        // Cut the polygon with each hole touching it, in order
+        std::vector<ConvexPolygon> &pieces = result[i];
+        difference(clipper, polygons[i], holes[hits[begin].hole], pieces);
+        for(unsigned int h=begin+1;h<end && !pieces.empty();++h) {
+            const ConvexPolygon &hole = holes[hits[h].hole];
+            cut.clear();
+            for(ConvexPolygon &piece : pieces) {
+                if(piece.overlaps(hole))
+                    difference(clipper, piece, hole, cut);
+                else
+                    cut.push_back(std::move(piece));
+            }
+            pieces.swap(cut);
+        }
+        begin = end;
+    }
 
-        // First overlap
-        m_polygons[found].booleanDifference(hole, newpolys);
+    return result;
+}
 
-        // Check the reset
-        for(unsigned int i=found+1;i<m_polygons.size();++i) {
-            ConvexPolygon &p = m_polygons[i];
-            if(p.overlaps(hole))
-                p.booleanDifference(hole, newpolys);
-            else
-                newpolys.push_back(std::move(p));
+void Terrain::applyCut(const std::vector<unsigned int> &indices, const std::vector<std::vector<ConvexPolygon>> &pieces)
+{
+    // Replace the hit polygons in place. A polygon can be removed
+    // altogether or split into multiple smaller ones: the first piece
+    // takes the place of the original and the rest are appended to the end.
+    // Removed polygons are replaced by the last polygon in the list.
+    // Going from the highest index down, a polygon moved from the end
+    // has always been dealt with already.
+    for(unsigned int k=indices.size();k>0;--k) {
+        const unsigned int i = indices[k-1];
+        const std::vector<ConvexPolygon> &p = pieces[k-1];
+
+        if(p.empty()) {
+            removePolygon(i);
+        } else {
+            replacePolygon(i, p[0]);
+            for(unsigned int j=1;j<p.size();++j)
+                appendPolygon(p[j]);
         }
-        //newpolys.push_back(hole);
-        m_polygons = std::move(newpolys);
-        m_dirty = true;
     }
 
-    return found>=0;
+    m_dirty = true;
+}
+
+bool Terrain::isFragmented() const
+{
+    return m_polygons.size() >= MIN_FRAGMENTS && m_polygons.size() >= m_basecount * FRAGMENTATION;
 }
 
-void Terrain::draw(const glm::mat4 &transform) const
+void Terrain::startCompaction(float minarea)
 {
-    glBindVertexArray(m_vao);
-    glUseProgram(m_program);
-    glUniformMatrix4fv(m_uniform_mvp, 1, GL_FALSE, &transform[0][0]);
+    assert(!m_compacting);
+
+    std::shared_ptr<std::vector<ConvexPolygon>> polygons(new std::vector<ConvexPolygon>(m_polygons.toVector()));
+    m_compaction = ThreadPool::runBackground([polygons, minarea]() -> boost::any {
+        return std::shared_ptr<std::vector<ConvexPolygon>>(
+            new std::vector<ConvexPolygon>(compactPolygons(*polygons, minarea)));
+    });
+    m_compacting = true;
+}
+
+void Terrain::finishCompaction()
+{
+    assert(m_compacting);
+
+    // The cut refers to the polygons by index
+    if(m_cutting)
+        finishNibble();
+
+    std::shared_ptr<std::vector<ConvexPolygon>> result =
+        boost::any_cast<std::shared_ptr<std::vector<ConvexPolygon>>>(m_compaction.get());
+    m_compacting = false;
+
+    setPolygons(*result);
+    m_basecount = m_polygons.size();
 
-    glDrawArrays(GL_LINES, 0, m_gl_points);
-    glBindVertexArray(0);
+    // Catch up with the changes made in the mean time
+    std::vector<ConvexPolygon> holes;
+    holes.swap(m_compactionholes);
+    if(!holes.empty())
+        nibble(holes);
+}
+
+void Terrain::setPolygons(const std::vector<ConvexPolygon> &polygons)
+{
+    m_polygons = PolygonSet(polygons);
+
+    m_tree.clear();
+    m_proxies.clear();
+    for(unsigned int i=0;i<m_polygons.size();++i)
+        m_proxies.push_back(m_tree.insert(m_polygons[i].bounds(), i));
+
+    // All polygons are uploaded again on the next update
+    m_freed.insert(m_freed.end(), m_slots.begin(), m_slots.end());
+    m_slots.assign(m_polygons.size(), Slot());
+    m_dirty = true;
+}
+
+void Terrain::replacePolygon(unsigned int i, const ConvexPolygon &poly)
+{
+    m_polygons.replace(i, poly);
+    m_tree.update(m_proxies[i], poly.bounds());
+
+    m_freed.push_back(m_slots[i]);
+    m_slots[i] = Slot();
+}
+
+void Terrain::appendPolygon(const ConvexPolygon &poly)
+{
+    m_proxies.push_back(m_tree.insert(poly.bounds(), m_polygons.size()));
+    m_polygons.append(poly);
+    m_slots.push_back(Slot());
+}
+
+void Terrain::removePolygon(unsigned int i)
+{
+    m_tree.remove(m_proxies[i]);
+    m_freed.push_back(m_slots[i]);
+
+    const unsigned int last = m_polygons.size() - 1;
+    if(i != last) {
+        m_proxies[i] = m_proxies[last];
+        m_slots[i] = m_slots[last];
+        m_tree.setData(m_proxies[i], i);
+    }
+    m_polygons.remove(i);
+    m_proxies.pop_back();
+    m_slots.pop_back();
+}
+
+void Terrain::setBuffer(TerrainBuffer *buffer)
+{
+    if(buffer == m_buffer)
+        return;
+
+    if(m_buffer) {
+        for(const Slot &slot : m_freed)
+            m_buffer->release(slot);
+        for(const Slot &slot : m_slots)
+            m_buffer->release(slot);
+    }
+    m_freed.clear();
+    m_slots.assign(m_polygons.size(), Slot());
+    m_ranges.clear();
+
+    m_buffer = buffer;
+    m_dirty = true;
 }
 
 void Terrain::updateGl()
@@ -126,28 +343,28 @@ void Terrain::updateGl()
     if(!m_dirty)
         return;
 
-    // Gather terrain triangles
-    std::vector<Point> points;
-    for(const ConvexPolygon &poly : m_polygons)
-        poly.toTriangles(points);
-    m_gl_points = points.size();
-
-    glBindVertexArray(m_vao);
+    // Nothing to upload in headless mode
+    if(!m_buffer || resource::Resources::getInstance().isHeadless()) {
+        m_freed.clear();
+        m_dirty = false;
+        return;
+    }
 
-    // Vertex data
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbuffer);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        sizeof(Point) * m_gl_points,
-        points.data(),
-        GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    for(const Slot &slot : m_freed)
+        m_buffer->release(slot);
+    m_freed.clear();
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Upload new polygons into free slots
+    m_ranges.clear();
+    for(unsigned int i=0;i<m_polygons.size();++i) {
+        if(m_slots[i].first < 0)
+            m_slots[i] = m_buffer->add(m_polygons[i]);
+        m_ranges.push_back(TerrainBuffer::Range { m_slots[i].firstindex, m_slots[i].indexcount });
+    }
+    TerrainBuffer::mergeRanges(m_ranges);
 
     m_dirty = false;
 }
 
 }
+
@@ -20,7 +20,11 @@
 
 #include <GL/glfw.h>
 
-#include "polygon.h"
+#include "polygonset.h"
+#include "clip.h"
+#include "aabbtree.h"
+#include "terrainbuffer.h"
+#include "../util/threadpool.h"
 
 namespace terrain {
 
@@ -38,15 +42,39 @@ public:
     explicit Terrain(const std::vector<ConvexPolygon> &polygons);
     ~Terrain();
 
+    /**
+     * Set the buffer the polygons are drawn from.
+     *
+     * Many terrain blocks can share the same buffer. Polygons already
+     * uploaded to a previous buffer are removed from it.
+     * updateGl() must be called afterwards to upload the polygons.
+     *
+     * @param buffer the buffer to use (may be null)
+     */
+    void setBuffer(TerrainBuffer *buffer);
+
     /**
      * Update OpenGL buffers.
      *
-     * This must be called before calling draw() after the polygons have been
-     * changed. Calling this function repeatedly does not incur a performance
+     * This must be called before drawing the terrain buffer after the polygons
+     * have been changed. Calling this function repeatedly does not incur a performance
      * penalty: if no changes have been made, the function will return immediately.
+     *
+     * Each polygon has its own slot in the terrain buffer, so only
+     * the polygons created since the last update are uploaded.
      */
     void updateGl();
 
+    /**
+     * Get the index ranges of this block's polygons in the terrain buffer.
+     *
+     * Polygons in neighbouring slots are joined into a single range.
+     * The ranges are up to date after updateGl().
+     *
+     * @return index ranges to pass to TerrainBuffer::draw()
+     */
+    const std::vector<TerrainBuffer::Range> &indexRanges() const { return m_ranges; }
+
     /**
      * Make a hole in the terrain.
      *
@@ -56,13 +84,108 @@ public:
      * @return true if the terrain was changed
      */
     bool nibble(const ConvexPolygon &hole);
- 
+
+    /**
+     * Make many holes in the terrain at once.
+     *
+     * This gives the same result as calling nibble() for each hole
+     * in order, but each polygon is cut by all the holes touching it
+     * in one go.
+     *
+     * updateGl() must be called afterwards to update the graphics.
+     *
+     * @param holes hole polygons
+     * @return true if the terrain was changed
+     */
+    bool nibble(const std::vector<ConvexPolygon> &holes);
+
+    /**
+     * Start making holes in the background.
+     *
+     * The polygons touching the holes are copied and cut on the
+     * background worker (see ThreadPool::runBackground()), so the cut
+     * never holds up the parallel loops of the simulation step.
+     * The terrain itself does not change until finishNibble() is
+     * called, so in the mean time collisions still see the polygons
+     * as they were before the cut. Since terrain is only ever removed,
+     * this errs on the side of solid ground.
+     *
+     * If a previous cut is still in progress, it is finished first.
+     *
+     * @param holes hole polygons
+     * @return true if the terrain will be changed
+     */
+    bool startNibble(const std::vector<ConvexPolygon> &holes);
+
+    /**
+     * Apply the result of the background cut.
+     *
+     * If the cut is still running, this waits for it to finish.
+     * The result is the same as if nibble() had been called with the
+     * same holes when startNibble() was called.
+     * updateGl() must be called afterwards to update the graphics.
+     *
+     */
+    void finishNibble();
+
+    /**
+     * Check if a background cut is in progress.
+     *
+     * @return true if startNibble() has started a cut that has not been finished yet
+     */
+    bool isCutting() const { return m_cutting; }
+
+    /**
+     * Select the polygon clipping backend used by nibble().
+     *
+     * The default is TRACE_CLIPPER.
+     *
+     * @param clipper the backend to use
+     */
+    void setClipper(Clipper clipper) { m_clipper = clipper; }
+
+    /**
+     * Get the polygon clipping backend.
+     *
+     * @return clipping backend
+     */
+    Clipper clipper() const { return m_clipper; }
+
+    /**
+     * Check if the terrain has been split into many more polygons
+     * than it had originally or after the last compaction.
+     *
+     * @return true if compaction is recommended
+     */
+    bool isFragmented() const;
+
+    /**
+     * Start compacting the polygons in the background.
+     *
+     * A copy of the polygon list is compacted on the background worker
+     * (see compactPolygons() and ThreadPool::runBackground().) The terrain
+     * can be used and nibbled normally in the mean time.
+     *
+     * @param minarea polygons smaller than this are removed
+     */
+    void startCompaction(float minarea);
+
+    /**
+     * Swap in the result of the background compaction.
+     *
+     * If the compaction is still running, this waits for it to finish.
+     * A background cut in progress is finished first.
+     * Holes made after the compaction started are reapplied to the result.
+     * updateGl() must be called afterwards to update the graphics.
+     */
+    void finishCompaction();
+
     /**
-     * Draw the terrain
+     * Check if a compaction is in progress.
      *
-     * @param transform transformation matrix
+     * @return true if startCompaction() has been called but finishCompaction() not yet.
      */
-    void draw(const glm::mat4 &transform) const;
+    bool isCompacting() const { return m_compacting; }
 
     /**
      * Check if the given point is inside this terrain block.
@@ -87,16 +210,108 @@ public:
      */
     bool circleCollision(const Point &p, float r, const glm::vec2 &v, Point &cp, glm::vec2 &normal) const;
 
+    /**
+     * Get the polygons that make up this terrain block.
+     *
+     * @return list of convex polygons
+     */
+    const PolygonSet &polygons() const { return m_polygons; }
+
+    /**
+     * Check if all of this terrain has been destroyed.
+     *
+     * @return true if there are no polygons left
+     */
+    bool isEmpty() const { return m_polygons.empty(); }
+
+    /**
+     * Get the bounding rectangle of the whole terrain block.
+     *
+     * Must not be called if the terrain is empty.
+     *
+     * @return bounding rectangle
+     */
+    const BRect &bounds() const { return m_tree.bounds(); }
+
 private:
+    typedef TerrainBuffer::Slot Slot;
+
     void updateGl() const;
 
-    std::vector<ConvexPolygon> m_polygons;
+    // Holes touching each polygon. The hits are sorted by polygon index
+    // and the holes of each polygon are in the order they were given.
+    struct Hit {
+        unsigned int polygon;
+        unsigned int hole;
+        bool operator<(const Hit &h) const {
+            return polygon < h.polygon || (polygon == h.polygon && hole < h.hole);
+        }
+    };
+
+    // Find the polygons that overlap the holes and make copies of them.
+    // The polygon index of each hit refers to the list of copies and
+    // indices has the index of each copied polygon in the terrain.
+    void findHits(const std::vector<ConvexPolygon> &holes, std::vector<Hit> &hits,
+        std::vector<unsigned int> &indices, std::vector<ConvexPolygon> &polygons) const;
+
+    // Cut each polygon with the holes touching it and return the pieces
+    // of each polygon. This does not touch the terrain, so it can be
+    // run in a worker thread.
+    static std::vector<std::vector<ConvexPolygon>> cutPolygons(
+        Clipper clipper,
+        const std::vector<ConvexPolygon> &polygons,
+        const std::vector<Hit> &hits,
+        const std::vector<ConvexPolygon> &holes);
+
+    // Replace the polygons with the given indices (in ascending order)
+    // with the pieces left after cutting
+    void applyCut(const std::vector<unsigned int> &indices, const std::vector<std::vector<ConvexPolygon>> &pieces);
+
+    // Replace polygon i with the given one
+    void replacePolygon(unsigned int i, const ConvexPolygon &poly);
+
+    // Add a polygon to the end of the list
+    void appendPolygon(const ConvexPolygon &poly);
+
+    // Remove polygon i. The last polygon is moved in its place
+    void removePolygon(unsigned int i);
+
+    // Replace all polygons
+    void setPolygons(const std::vector<ConvexPolygon> &polygons);
+
+    PolygonSet m_polygons;
+
+    // Bounding volume hierarchy for the polygons.
+    // m_proxies[i] is the tree leaf for polygon i.
+    AABBTree m_tree;
+    std::vector<int> m_proxies;
+
+    // m_slots[i] is the terrain buffer slot of polygon i.
+    // Slots of removed polygons are released on the next update.
+    TerrainBuffer *m_buffer;
+    std::vector<Slot> m_slots;
+    std::vector<Slot> m_freed;
+    std::vector<TerrainBuffer::Range> m_ranges;
+
+    // Background compaction. Holes made while the compaction is
+    // running are collected so they can be applied to the result.
+    TaskFuture m_compaction;
+    std::vector<ConvexPolygon> m_compactionholes;
+    bool m_compacting;
+
+    // Background cut. The polygons are not changed until the
+    // result is applied, so the indices of the hit polygons stay valid.
+    TaskFuture m_cut;
+    std::vector<unsigned int> m_cutpolygons;
+    std::vector<ConvexPolygon> m_cutholes;
+    bool m_cutting;
+
+    // Number of polygons after construction or the last compaction
+    unsigned int m_basecount;
+
+    Clipper m_clipper;
+
     bool m_dirty;
-    GLuint m_vao;
-    GLuint m_vbuffer;
-    GLuint m_program;
-    GLuint m_uniform_mvp;
-    GLsizei m_gl_points;
 };
 
 }
@@ -0,0 +1,219 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <GL/glew.h>
+
+#include "terrainbuffer.h"
+#include "../res/shader.h"
+#include "../renderqueue.h"
+
+namespace terrain {
+
+namespace {
+    // Initial buffer sizes. A fan of n points has 3 * (n - 2) indices
+    const unsigned int INITIAL_VERTICES = 4096;
+    const unsigned int INITIAL_INDICES = INITIAL_VERTICES * 2;
+
+    // Make a bigger copy of a buffer object
+    void resizeBuffer(GLenum usage, GLuint &buffer, GLsizeiptr oldsize, GLsizeiptr newsize)
+    {
+        GLuint newbuffer;
+        glGenBuffers(1, &newbuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newbuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newsize, nullptr, usage);
+
+        if(buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldsize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = newbuffer;
+    }
+}
+
+TerrainBuffer::TerrainBuffer(GLenum usage)
+    : m_usage(usage), m_vao(0), m_vbuffer(0), m_ibuffer(0),
+      m_program(0), m_uniform_mvp(0), m_uniform_color(0)
+{
+}
+
+TerrainBuffer::~TerrainBuffer()
+{
+    if(m_vao) {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbuffer);
+        glDeleteBuffers(1, &m_ibuffer);
+    }
+}
+
+TerrainBuffer::Slot TerrainBuffer::add(const PolygonView &poly)
+{
+    assert(poly.vertexCount() >= 3);
+
+    Slot slot;
+    slot.count = poly.vertexCount();
+    slot.indexcount = 3 * (slot.count - 2);
+
+    if(!m_vao)
+        grow(slot.count, slot.indexcount);
+
+    slot.first = m_vertices.allocate(slot.count);
+    slot.firstindex = m_indices.allocate(slot.indexcount);
+    if(slot.first < 0 || slot.firstindex < 0) {
+        if(slot.first >= 0)
+            m_vertices.release(slot.first, slot.count);
+        if(slot.firstindex >= 0)
+            m_indices.release(slot.firstindex, slot.indexcount);
+
+        grow(slot.count, slot.indexcount);
+        slot.first = m_vertices.allocate(slot.count);
+        slot.firstindex = m_indices.allocate(slot.indexcount);
+        assert(slot.first >= 0 && slot.firstindex >= 0);
+    }
+
+    // Triangle fan around the first point
+    m_fan.clear();
+    for(int i=1;i<slot.count-1;++i) {
+        m_fan.push_back(slot.first);
+        m_fan.push_back(slot.first + i);
+        m_fan.push_back(slot.first + i + 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbuffer);
+    glBufferSubData(
+        GL_ARRAY_BUFFER,
+        sizeof(Point) * slot.first,
+        sizeof(Point) * slot.count,
+        &poly.vertex(0));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The element array binding is part of the VAO state, so the
+    // index buffer is updated through the copy target instead.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibuffer);
+    glBufferSubData(
+        GL_COPY_WRITE_BUFFER,
+        sizeof(GLuint) * slot.firstindex,
+        sizeof(GLuint) * slot.indexcount,
+        m_fan.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return slot;
+}
+
+void TerrainBuffer::release(const Slot &slot)
+{
+    if(slot.first < 0)
+        return;
+
+    m_vertices.release(slot.first, slot.count);
+    m_indices.release(slot.firstindex, slot.indexcount);
+
+    // Turn the triangles into degenerate ones. This is needed even
+    // above the top, since a later allocation may not cover the whole range.
+    m_fan.assign(slot.indexcount, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibuffer);
+    glBufferSubData(
+        GL_COPY_WRITE_BUFFER,
+        sizeof(GLuint) * slot.firstindex,
+        sizeof(GLuint) * slot.indexcount,
+        m_fan.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void TerrainBuffer::grow(unsigned int vertices, unsigned int indices)
+{
+    if(!m_vao) {
+        glGenVertexArrays(1, &m_vao);
+
+        m_program = resource::get<resource::Program>("core.shader.terrain")->id();
+        m_uniform_mvp = glGetUniformLocation(m_program, "MVP");
+        m_uniform_color = glGetUniformLocation(m_program, "color");
+    }
+
+    // Allocated ranges keep their place, so existing
+    // indices remain valid in the bigger buffers.
+    const unsigned int oldvertices = m_vertices.size();
+    const unsigned int oldindices = m_indices.size();
+
+    m_vertices.grow(std::max(std::max(INITIAL_VERTICES, oldvertices * 2), oldvertices + vertices));
+    m_indices.grow(std::max(std::max(INITIAL_INDICES, oldindices * 2), oldindices + indices));
+
+    resizeBuffer(m_usage, m_vbuffer, sizeof(Point) * oldvertices, sizeof(Point) * m_vertices.size());
+    resizeBuffer(m_usage, m_ibuffer, sizeof(GLuint) * oldindices, sizeof(GLuint) * m_indices.size());
+
+    glBindVertexArray(m_vao);
+
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbuffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibuffer);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TerrainBuffer::draw(RenderQueue &queue, int layer, const glm::mat4 &transform, const glm::vec4 &color, bool blend,
+    const std::vector<Range> &ranges) const
+{
+    if(ranges.empty())
+        return;
+
+    m_drawranges = ranges;
+    mergeRanges(m_drawranges);
+
+    m_drawcounts.clear();
+    m_drawoffsets.clear();
+    for(const Range &r : m_drawranges) {
+        m_drawcounts.push_back(r.count);
+        m_drawoffsets.push_back(reinterpret_cast<const GLvoid*>(sizeof(GLuint) * r.first));
+    }
+
+    const GLint uniform = m_uniform_color;
+    const std::vector<GLsizei> &counts = m_drawcounts;
+    const std::vector<const GLvoid*> &offsets = m_drawoffsets;
+    queue.submit(RenderQueue::Item {
+        layer, m_program, m_vao, nullptr, blend, m_uniform_mvp, transform,
+        [uniform, color, &counts, &offsets]() {
+            glUniform4fv(uniform, 1, &color[0]);
+            glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size());
+        }
+    });
+}
+
+void TerrainBuffer::mergeRanges(std::vector<Range> &ranges)
+{
+    if(ranges.empty())
+        return;
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.first < b.first; });
+
+    unsigned int last = 0;
+    for(unsigned int i=1;i<ranges.size();++i) {
+        if(ranges[i].first == ranges[last].first + ranges[last].count)
+            ranges[last].count += ranges[i].count;
+        else
+            ranges[++last] = ranges[i];
+    }
+    ranges.resize(last + 1);
+}
+
+}
+
@@ -0,0 +1,152 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_TERRAINBUFFER_H
+#define LUOLA_TERRAIN_TERRAINBUFFER_H
+
+#include <vector>
+
+#include <GL/glfw.h>
+#include <glm/glm.hpp>
+
+#include "polygon.h"
+#include "../util/rangeallocator.h"
+
+class RenderQueue;
+
+namespace terrain {
+
+/**
+ * A vertex and index buffer shared by many terrain blocks.
+ *
+ * Each convex polygon is stored as a triangle fan: its points go in
+ * the vertex buffer and the indices of its triangles in the index buffer.
+ * Both are sub-allocated, so polygons can be added and removed at any
+ * time. The index ranges of removed polygons are overwritten with
+ * degenerate triangles, so neighbouring ranges can be drawn together
+ * without skipping the holes between them.
+ *
+ * Each terrain block keeps the index ranges of its own polygons.
+ * The ranges of the visible blocks are drawn with a single
+ * glMultiDrawElements call.
+ *
+ * The buffers grow as needed. OpenGL objects are not created until
+ * the first polygon is added.
+ */
+class TerrainBuffer {
+public:
+    //! The vertex and index ranges of a polygon
+    struct Slot {
+        Slot() : first(-1), count(0), firstindex(0), indexcount(0) { }
+        GLint first; // -1 if not in the buffer
+        GLsizei count;
+        GLint firstindex;
+        GLsizei indexcount;
+    };
+
+    //! A range of indices to draw
+    struct Range {
+        GLint first;
+        GLsizei count;
+    };
+
+    /**
+     * Construct an empty terrain buffer.
+     *
+     * @param usage buffer usage hint: GL_STATIC_DRAW for terrain that does not change
+     */
+    explicit TerrainBuffer(GLenum usage);
+    TerrainBuffer(const TerrainBuffer&) = delete;
+    ~TerrainBuffer();
+
+    /**
+     * Upload a polygon.
+     *
+     * @param poly the polygon to add
+     * @return the ranges the polygon was put in
+     */
+    Slot add(const PolygonView &poly);
+
+    /**
+     * Remove a polygon.
+     *
+     * Slots that were never uploaded are ignored.
+     *
+     * @param slot the slot returned by add()
+     */
+    void release(const Slot &slot);
+
+    /**
+     * Check if there is anything to draw.
+     *
+     * @return true if no polygons are in the buffer
+     */
+    bool isEmpty() const { return m_indices.top() == 0; }
+
+    /**
+     * Queue index ranges for drawing.
+     *
+     * The ranges are sorted and touching ranges are joined, so the
+     * ranges of neighbouring blocks are drawn as one. They are drawn
+     * when the queue is flushed, so draw() must be called only once
+     * per buffer between flushes.
+     *
+     * @param queue the render queue
+     * @param layer the layer to draw on
+     * @param transform transformation matrix
+     * @param color fill color
+     * @param blend enable alpha blending
+     * @param ranges the index ranges to draw
+     */
+    void draw(RenderQueue &queue, int layer, const glm::mat4 &transform, const glm::vec4 &color, bool blend,
+        const std::vector<Range> &ranges) const;
+
+    /**
+     * Sort the ranges and join the ones that touch.
+     *
+     * @param ranges the ranges to merge
+     */
+    static void mergeRanges(std::vector<Range> &ranges);
+
+private:
+    // Make the buffers big enough for the given number of extra vertices and indices
+    void grow(unsigned int vertices, unsigned int indices);
+
+    GLenum m_usage;
+    RangeAllocator m_vertices;
+    RangeAllocator m_indices;
+
+    // Scratch space for index uploads
+    std::vector<GLuint> m_fan;
+
+    // The ranges to draw, set by draw() and read when the queue is flushed
+    mutable std::vector<Range> m_drawranges;
+    mutable std::vector<GLsizei> m_drawcounts;
+    mutable std::vector<const GLvoid*> m_drawoffsets;
+
+    GLuint m_vao;
+    GLuint m_vbuffer;
+    GLuint m_ibuffer;
+    GLuint m_program;
+    GLint m_uniform_mvp;
+    GLint m_uniform_color;
+};
+
+}
+
+#endif
+
@@ -70,6 +70,16 @@ public:
      * Set zone air density
      */
     void setZoneDensity(float density) { m_density = density; }
+
+    /**
+     * Get the zone force vector
+     */
+    const glm::vec2 &zoneForce() const { return m_force; }
+
+    /**
+     * Get the zone air density (if set)
+     */
+    const Optional<float> &zoneDensity() const { return m_density; }
  
 private:
     glm::vec2 m_force;
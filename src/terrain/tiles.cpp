@@ -0,0 +1,115 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <map>
+
+#include "tiles.h"
+
+namespace terrain {
+
+namespace {
+    // Pieces smaller than this (relative to the tile area) are dropped
+    const float MIN_AREA = 1e-6f;
+
+    float area(const Points &points)
+    {
+        float a = 0;
+        for(unsigned int i=0;i<points.size();++i) {
+            const Point &p = points[i];
+            const Point &q = points[(i+1) % points.size()];
+            a += p.x * q.y - p.y * q.x;
+        }
+        return a * 0.5f;
+    }
+
+    // Clip the polygon to one side of an axis aligned line.
+    // The kept side is where the coordinate is >= (sign 1) or <= (sign -1) the line.
+    // Intersection points are put exactly on the line.
+    void clipAxis(const Points &in, int axis, float line, float sign, Points &out)
+    {
+        out.clear();
+        for(unsigned int i=0;i<in.size();++i) {
+            const Point &a = in[i];
+            const Point &b = in[(i+1) % in.size()];
+            const float da = (a[axis] - line) * sign;
+            const float db = (b[axis] - line) * sign;
+
+            if(da >= 0)
+                out.push_back(a);
+
+            if((da < 0 && db > 0) || (da > 0 && db < 0)) {
+                Point p = a + (b - a) * (da / (da - db));
+                p[axis] = line;
+                out.push_back(p);
+            }
+        }
+
+        // Remove duplicate vertices left by points lying on the line
+        unsigned int n = 0;
+        for(unsigned int i=0;i<out.size();++i) {
+            if(n == 0 || out[i] != out[n-1])
+                out[n++] = out[i];
+        }
+        while(n > 1 && out[n-1] == out[0])
+            --n;
+        out.resize(n);
+    }
+}
+
+std::vector<std::vector<ConvexPolygon>> splitTiles(const std::vector<ConvexPolygon> &polygons, float tilesize)
+{
+    // Tiles are keyed by (row, column) so they come out in row order
+    std::map<std::pair<int, int>, std::vector<ConvexPolygon>> tiles;
+    const float minarea = MIN_AREA * tilesize * tilesize;
+
+    Points a, b;
+    for(const ConvexPolygon &poly : polygons) {
+        const BRect &bounds = poly.bounds();
+        const int x0 = std::floor(bounds.left() / tilesize);
+        const int y0 = std::floor(bounds.bottom() / tilesize);
+        const int x1 = std::floor(bounds.right() / tilesize);
+        const int y1 = std::floor(bounds.top() / tilesize);
+
+        // Polygons that fit inside a tile are kept as they are
+        if(x0 == x1 && y0 == y1) {
+            tiles[std::make_pair(y0, x0)].push_back(poly);
+            continue;
+        }
+
+        for(int y=y0;y<=y1;++y) {
+            for(int x=x0;x<=x1;++x) {
+                clipAxis(poly.vertices(), 0, x * tilesize, 1, a);
+                clipAxis(a, 0, (x + 1) * tilesize, -1, b);
+                clipAxis(b, 1, y * tilesize, 1, a);
+                clipAxis(a, 1, (y + 1) * tilesize, -1, b);
+
+                if(b.size() >= 3 && std::fabs(area(b)) > minarea)
+                    tiles[std::make_pair(y, x)].push_back(ConvexPolygon(b));
+            }
+        }
+    }
+
+    std::vector<std::vector<ConvexPolygon>> result;
+    result.reserve(tiles.size());
+    for(auto &tile : tiles)
+        result.push_back(std::move(tile.second));
+    return result;
+}
+
+}
+
@@ -0,0 +1,45 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_TILES_H
+#define LUOLA_TERRAIN_TILES_H
+
+#include "polygon.h"
+
+namespace terrain {
+
+/**
+ * Split polygons into square tiles.
+ *
+ * Each polygon is clipped to every tile of a fixed world space grid it
+ * overlaps. The tile borders are at multiples of the tile size, so the
+ * pieces on either side of a border meet exactly and the same grid can
+ * be used for every terrain block. Slivers left by the clipping are dropped.
+ *
+ * Tiles are returned row by row from the bottom left. Empty tiles
+ * are left out. The result is deterministic.
+ *
+ * @param polygons the polygons to split
+ * @param tilesize width and height of a tile. Must be greater than zero
+ * @return the polygons of each nonempty tile
+ */
+std::vector<std::vector<ConvexPolygon>> splitTiles(const std::vector<ConvexPolygon> &polygons, float tilesize);
+
+}
+
+#endif
+
@@ -0,0 +1,210 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cmath>
+
+#include "zoneindex.h"
+#include "clip.h"
+
+namespace terrain {
+
+namespace {
+    // Number of cells along the longer side of the level
+    const int GRID_SIZE = 128;
+
+    ConvexPolygon cellPolygon(const Point &origin, int x, int y, float cellsize)
+    {
+        const Point bl = origin + Point(x, y) * cellsize;
+        const Point tr = bl + Point(cellsize, cellsize);
+        return ConvexPolygon(Points { bl, Point(tr.x, bl.y), tr, Point(bl.x, tr.y) });
+    }
+}
+
+ZoneIndex::ZoneIndex()
+    : m_invcellsize(0), m_width(0), m_height(0), m_built(false)
+{
+}
+
+void ZoneIndex::clear()
+{
+    m_zones.clear();
+    m_cells.clear();
+    m_entries.clear();
+    m_width = 0;
+    m_height = 0;
+    m_built = false;
+}
+
+void ZoneIndex::build(const std::vector<Zone*> &zones, const BRect &bounds)
+{
+    clear();
+    m_zones = zones;
+    m_built = true;
+
+    const float cellsize = std::max(bounds.width(), bounds.height()) / GRID_SIZE;
+    if(zones.empty() || !(cellsize > 0))
+        return;
+
+    m_origin = bounds.btmleft();
+    m_invcellsize = 1.0f / cellsize;
+    m_width = std::max(1, int(std::ceil(bounds.width() * m_invcellsize)));
+    m_height = std::max(1, int(std::ceil(bounds.height() * m_invcellsize)));
+
+    // Find out which zone polygons touch each cell.
+    // Zones are processed in order, so the entries of each cell
+    // will be in the order the zones must be applied.
+    std::vector<std::vector<Entry>> touching(m_width * m_height);
+
+    for(unsigned int z=0;z<zones.size();++z) {
+        const PolygonSet &polys = zones[z]->polygons();
+        for(unsigned int pi=0;pi<polys.size();++pi) {
+            const PolygonView poly = polys[pi];
+            const BRect &b = poly.bounds();
+
+            const int x0 = std::max(0, int(std::floor((b.left() - m_origin.x) * m_invcellsize)));
+            const int y0 = std::max(0, int(std::floor((b.bottom() - m_origin.y) * m_invcellsize)));
+            const int x1 = std::min(m_width - 1, int(std::floor((b.right() - m_origin.x) * m_invcellsize)));
+            const int y1 = std::min(m_height - 1, int(std::floor((b.top() - m_origin.y) * m_invcellsize)));
+
+            for(int y=y0;y<=y1;++y) {
+                for(int x=x0;x<=x1;++x) {
+                    const ConvexPolygon cellpoly = cellPolygon(m_origin, x, y, cellsize);
+
+                    if(poly.envelopes(cellpoly))
+                        touching[y * m_width + x].push_back(Entry { z, -1 });
+                    else if(poly.overlaps(cellpoly))
+                        touching[y * m_width + x].push_back(Entry { z, int(pi) });
+                }
+            }
+        }
+    }
+
+    // Generate cells
+    m_cells.resize(m_width * m_height);
+    std::vector<Entry> merged;
+    std::vector<ConvexPolygon> rest, cut;
+    for(unsigned int c=0;c<m_cells.size();++c) {
+        const std::vector<Entry> &entries = touching[c];
+        Cell &cell = m_cells[c];
+
+        // A zone that covers the whole cell needs just one entry.
+        // If every zone touching the cell covers it, the cell is uniform.
+        merged.clear();
+        bool uniform = true;
+        for(unsigned int i=0;i<entries.size();) {
+            unsigned int j = i;
+            bool covers = false;
+            while(j<entries.size() && entries[j].zone == entries[i].zone) {
+                if(entries[j].polygon < 0)
+                    covers = true;
+                ++j;
+            }
+
+            // No single polygon covers the cell, but together they might.
+            // Subtract the polygons from the cell and see if anything is
+            // left. The fixed point clipper drops slivers narrower than
+            // its grid, so gaps that thin are ignored.
+            if(!covers && j - i > 1) {
+                const PolygonSet &polys = zones[entries[i].zone]->polygons();
+                rest.assign(1, cellPolygon(m_origin, c % m_width, c / m_width, cellsize));
+                for(unsigned int k=i;k<j && !rest.empty();++k) {
+                    const ConvexPolygon poly = polys[entries[k].polygon].toPolygon();
+                    cut.clear();
+                    for(const ConvexPolygon &r : rest)
+                        fixedDifference(r, poly, cut);
+                    rest.swap(cut);
+                }
+                covers = rest.empty();
+            }
+
+            if(covers) {
+                merged.push_back(Entry { entries[i].zone, -1 });
+            } else {
+                merged.insert(merged.end(), entries.begin() + i, entries.begin() + j);
+                uniform = false;
+            }
+            i = j;
+        }
+
+        cell.first = m_entries.size();
+        cell.count = 0;
+
+        if(uniform) {
+            for(const Entry &e : merged) {
+                cell.force += zones[e.zone]->zoneForce();
+                if(zones[e.zone]->zoneDensity().hasValue())
+                    cell.density = zones[e.zone]->zoneDensity();
+            }
+        } else {
+            m_entries.insert(m_entries.end(), merged.begin(), merged.end());
+            cell.count = merged.size();
+        }
+    }
+}
+
+ZoneProps ZoneIndex::zoneAt(const Point &p, const ZoneProps &root) const
+{
+    const float fx = (p.x - m_origin.x) * m_invcellsize;
+    const float fy = (p.y - m_origin.y) * m_invcellsize;
+
+    // Written this way so that NaNs also take the slow path
+    if(!(fx >= 0 && fx < m_width && fy >= 0 && fy < m_height))
+        return slowZoneAt(p, root);
+
+    const Cell &cell = m_cells[int(fy) * m_width + int(fx)];
+    ZoneProps zp = root;
+
+    if(cell.count == 0) {
+        zp.force += cell.force;
+        cell.density.assign(zp.density);
+        return zp;
+    }
+
+    // Apply each zone at most once, even if the point is
+    // inside more than one of its polygons.
+    unsigned int applied = m_zones.size();
+    for(uint32_t i=cell.first;i<cell.first+cell.count;++i) {
+        const Entry &e = m_entries[i];
+        if(e.zone == applied)
+            continue;
+
+        const Zone *z = m_zones[e.zone];
+        if(e.polygon < 0 || z->polygons()[e.polygon].hasPoint(p)) {
+            z->apply(zp);
+            applied = e.zone;
+        }
+    }
+
+    return zp;
+}
+
+ZoneProps ZoneIndex::slowZoneAt(const Point &p, const ZoneProps &root) const
+{
+    ZoneProps zp = root;
+
+    // A point can be part of multiple zones
+    for(const Zone *z : m_zones) {
+        if(z->hasPoint(p))
+            z->apply(zp);
+    }
+
+    return zp;
+}
+
+}
+
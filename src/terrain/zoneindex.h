@@ -0,0 +1,111 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_TERRAIN_ZONEINDEX_H
+#define LUOLA_TERRAIN_ZONEINDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "terrains.h"
+
+namespace terrain {
+
+/**
+ * Spatial index for zone property lookups.
+ *
+ * The level area is divided into a uniform grid. A cell that is either
+ * completely inside or completely outside of every zone gets the combined
+ * zone properties precalculated, so looking up a point in it is just an
+ * array access. A zone covers a cell if the cell is inside the union of
+ * its polygons, so edges between the polygons of a zone (such as tile
+ * seams) do not matter. For cells that are crossed by zone edges, the
+ * index keeps a list of the zone polygons touching the cell, so only
+ * those need to be tested.
+ *
+ * Zones are immutable, so the index is built once when the level has
+ * been loaded. Points outside the grid are looked up the slow way.
+ */
+class ZoneIndex {
+public:
+    ZoneIndex();
+
+    /**
+     * Build the index.
+     *
+     * The zone pointers are stored in the index, so the zones must
+     * live as long as the index is in use.
+     *
+     * @param zones the zones, in the order they should be applied
+     * @param bounds area to cover
+     */
+    void build(const std::vector<Zone*> &zones, const BRect &bounds);
+
+    /**
+     * Clear the index.
+     */
+    void clear();
+
+    /**
+     * Check if the index has been built.
+     *
+     * @return true if build() has been called since the last clear()
+     */
+    bool isBuilt() const { return m_built; }
+
+    /**
+     * Get the zone properties at the given point.
+     *
+     * @param p point in level space
+     * @param root root zone properties
+     * @return combined zone properties
+     */
+    ZoneProps zoneAt(const Point &p, const ZoneProps &root) const;
+
+private:
+    // A zone polygon touching a cell. Polygon index -1 means
+    // the whole cell is inside the zone.
+    struct Entry {
+        unsigned int zone;
+        int polygon;
+    };
+
+    struct Cell {
+        // Entries to test. If zero, the cached values below are used.
+        uint32_t first, count;
+
+        // Combined properties of the zones covering the whole cell
+        glm::vec2 force;
+        Optional<float> density;
+    };
+
+    ZoneProps slowZoneAt(const Point &p, const ZoneProps &root) const;
+
+    std::vector<Zone*> m_zones;
+    std::vector<Cell> m_cells;
+    std::vector<Entry> m_entries;
+
+    Point m_origin;
+    float m_invcellsize;
+    int m_width, m_height;
+    bool m_built;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,64 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_UTIL_ALIGNEDARRAY_H
+#define LUOLA_UTIL_ALIGNEDARRAY_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * A fixed size array aligned for SIMD access.
+ *
+ * The array is zero initialized. Only plain old data types
+ * should be stored in it.
+ */
+template<typename Type, unsigned int Alignment=32>
+class AlignedArray {
+public:
+    explicit AlignedArray(unsigned int size)
+        : m_size(size)
+    {
+        m_buffer = new char[size * sizeof(Type) + Alignment];
+        uintptr_t p = reinterpret_cast<uintptr_t>(m_buffer);
+        p = (p + Alignment - 1) & ~uintptr_t(Alignment - 1);
+        m_data = reinterpret_cast<Type*>(p);
+        memset(m_data, 0, size * sizeof(Type));
+    }
+
+    AlignedArray(const AlignedArray&) = delete;
+    AlignedArray &operator=(const AlignedArray&) = delete;
+
+    ~AlignedArray() { delete [] m_buffer; }
+
+    unsigned int size() const { return m_size; }
+
+    Type *data() { return m_data; }
+    const Type *data() const { return m_data; }
+
+    Type &operator[](unsigned int i) { assert(i < m_size); return m_data[i]; }
+    const Type &operator[](unsigned int i) const { assert(i < m_size); return m_data[i]; }
+
+private:
+    char *m_buffer;
+    Type *m_data;
+    unsigned int m_size;
+};
+
+#endif
+
@@ -0,0 +1,232 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_UTIL_POOL_H
+#define LUOLA_UTIL_POOL_H
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * A handle to an object stored in a Pool.
+ *
+ * The handle remains valid until the object is removed. The slot may
+ * then be reused for another object, but the generation counter is
+ * incremented so the stale handle will not resolve to the new object.
+ */
+struct PoolHandle {
+    PoolHandle() : slot(0), generation(0) { }
+    PoolHandle(uint32_t s, uint32_t g) : slot(s), generation(g) { }
+
+    /// Is this a null handle?
+    bool isNull() const { return generation == 0; }
+
+    bool operator==(const PoolHandle &h) const { return slot == h.slot && generation == h.generation; }
+    bool operator!=(const PoolHandle &h) const { return !(*this == h); }
+
+    uint32_t slot;
+    uint32_t generation;
+};
+
+/**
+ * A fixed capacity object pool.
+ *
+ * Objects are stored in a dense array, so iterating through them is
+ * cache friendly and the cost depends only on the number of live objects.
+ * Removal moves the last object into the freed position, so removing an
+ * object changes the index (but not the handle) of one other object.
+ */
+template<typename Type>
+class Pool {
+public:
+    typedef Type *iterator;
+    typedef const Type *const_iterator;
+
+    /**
+     * Construct an empty pool.
+     *
+     * All memory is allocated up front.
+     *
+     * @param capacity maximum number of objects the pool can hold
+     */
+    explicit Pool(unsigned int capacity)
+        : m_capacity(capacity), m_slots(capacity)
+    {
+        m_objects.reserve(capacity);
+        m_dense2slot.reserve(capacity);
+        m_freeslots.reserve(capacity);
+        for(unsigned int i=capacity;i>0;--i) {
+            m_slots[i-1].generation = 1;
+            m_freeslots.push_back(i-1);
+        }
+    }
+
+    /**
+     * Get the maximum number of objects in the pool.
+     *
+     * @return pool capacity
+     */
+    unsigned int capacity() const { return m_capacity; }
+
+    /**
+     * Get the number of live objects.
+     *
+     * @return object count
+     */
+    unsigned int size() const { return m_objects.size(); }
+
+    /**
+     * Check if the pool has room for more objects.
+     *
+     * @return true if pool is full
+     */
+    bool isFull() const { return m_freeslots.empty(); }
+
+    /**
+     * Add an object to the pool.
+     *
+     * @param obj the object to add
+     * @return handle to the new object or a null handle if the pool is full
+     */
+    PoolHandle add(const Type &obj)
+    {
+        if(isFull())
+            return PoolHandle();
+
+        const uint32_t slot = m_freeslots.back();
+        m_freeslots.pop_back();
+
+        m_slots[slot].dense = m_objects.size();
+        m_objects.push_back(obj);
+        m_dense2slot.push_back(slot);
+
+        return PoolHandle(slot, m_slots[slot].generation);
+    }
+
+    /**
+     * Get the object the handle points to.
+     *
+     * @param h object handle
+     * @return pointer to the object or nullptr if the handle is stale
+     */
+    Type *get(const PoolHandle &h)
+    {
+        if(!isValid(h))
+            return nullptr;
+        return &m_objects[m_slots[h.slot].dense];
+    }
+
+    const Type *get(const PoolHandle &h) const
+    {
+        if(!isValid(h))
+            return nullptr;
+        return &m_objects[m_slots[h.slot].dense];
+    }
+
+    /**
+     * Check if the handle points to a live object.
+     *
+     * @param h object handle
+     * @return true if the object exists
+     */
+    bool isValid(const PoolHandle &h) const
+    {
+        return !h.isNull() && h.slot < m_capacity && m_slots[h.slot].generation == h.generation;
+    }
+
+    /**
+     * Remove the object the handle points to.
+     *
+     * Stale handles are ignored.
+     *
+     * @param h object handle
+     */
+    void remove(const PoolHandle &h)
+    {
+        if(isValid(h))
+            removeAt(m_slots[h.slot].dense);
+    }
+
+    /**
+     * Remove the object at the given index.
+     *
+     * The last object is moved to the freed index. When removing
+     * objects while iterating, do not advance the index after removal.
+     *
+     * @param i object index. Must be in range [0..size()[
+     */
+    void removeAt(unsigned int i)
+    {
+        assert(i < m_objects.size());
+
+        const uint32_t slot = m_dense2slot[i];
+        const uint32_t last = m_objects.size() - 1;
+        if(i != last) {
+            m_objects[i] = std::move(m_objects[last]);
+            m_dense2slot[i] = m_dense2slot[last];
+            m_slots[m_dense2slot[i]].dense = i;
+        }
+        m_objects.pop_back();
+        m_dense2slot.pop_back();
+
+        // Invalidate old handles. Generation zero is reserved for null handles.
+        if(++m_slots[slot].generation == 0)
+            m_slots[slot].generation = 1;
+        m_freeslots.push_back(slot);
+    }
+
+    /**
+     * Get the handle of the object at the given index.
+     *
+     * @param i object index
+     * @return object handle
+     */
+    PoolHandle handleAt(unsigned int i) const
+    {
+        const uint32_t slot = m_dense2slot[i];
+        return PoolHandle(slot, m_slots[slot].generation);
+    }
+
+    Type &operator[](unsigned int i) { return m_objects[i]; }
+    const Type &operator[](unsigned int i) const { return m_objects[i]; }
+
+    iterator begin() { return m_objects.data(); }
+    iterator end() { return m_objects.data() + m_objects.size(); }
+    const_iterator begin() const { return m_objects.data(); }
+    const_iterator end() const { return m_objects.data() + m_objects.size(); }
+
+private:
+    struct Slot {
+        uint32_t dense;
+        uint32_t generation;
+    };
+
+    unsigned int m_capacity;
+
+    // Live objects and the slots they belong to
+    std::vector<Type> m_objects;
+    std::vector<uint32_t> m_dense2slot;
+
+    // Slot table for handle lookup
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeslots;
+};
+
+#endif
+
@@ -0,0 +1,101 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cassert>
+
+#include "rangeallocator.h"
+
+RangeAllocator::RangeAllocator(unsigned int size)
+{
+    reset(size);
+}
+
+void RangeAllocator::reset(unsigned int size)
+{
+    m_free.clear();
+    m_size = size;
+    if(size > 0)
+        m_free[0] = size;
+}
+
+void RangeAllocator::grow(unsigned int size)
+{
+    assert(size >= m_size);
+    if(size == m_size)
+        return;
+
+    const unsigned int oldsize = m_size;
+    m_size = size;
+    release(oldsize, size - oldsize);
+}
+
+int RangeAllocator::allocate(unsigned int count)
+{
+    assert(count > 0);
+
+    for(auto i=m_free.begin();i!=m_free.end();++i) {
+        if(i->second >= count) {
+            const unsigned int first = i->first;
+            const unsigned int rest = i->second - count;
+            m_free.erase(i);
+            if(rest > 0)
+                m_free[first + count] = rest;
+            return first;
+        }
+    }
+
+    return -1;
+}
+
+void RangeAllocator::release(unsigned int first, unsigned int count)
+{
+    assert(count > 0 && first + count <= m_size);
+
+    auto next = m_free.lower_bound(first);
+    assert(next == m_free.end() || next->first >= first + count);
+
+    // Merge with the following range
+    if(next != m_free.end() && next->first == first + count) {
+        count += next->second;
+        next = m_free.erase(next);
+    }
+
+    // Merge with the preceding range
+    if(next != m_free.begin()) {
+        auto prev = next;
+        --prev;
+        assert(prev->first + prev->second <= first);
+        if(prev->first + prev->second == first) {
+            prev->second += count;
+            return;
+        }
+    }
+
+    m_free[first] = count;
+}
+
+unsigned int RangeAllocator::top() const
+{
+    if(m_free.empty())
+        return m_size;
+
+    auto last = m_free.rbegin();
+    if(last->first + last->second == m_size)
+        return last->first;
+    return m_size;
+}
+
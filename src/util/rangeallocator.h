@@ -0,0 +1,94 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_UTIL_RANGEALLOCATOR_H
+#define LUOLA_UTIL_RANGEALLOCATOR_H
+
+#include <map>
+
+/**
+ * Allocator for ranges of a fixed size linear space.
+ *
+ * This only does the bookkeeping: the space itself is typically
+ * something like a vertex buffer. Free ranges are kept sorted so
+ * adjacent ranges are merged when released.
+ */
+class RangeAllocator {
+public:
+    /**
+     * Construct an allocator.
+     *
+     * @param size total size of the space. Initially all free.
+     */
+    explicit RangeAllocator(unsigned int size=0);
+
+    /**
+     * Forget all allocations and change the total size.
+     *
+     * @param size new size
+     */
+    void reset(unsigned int size);
+
+    /**
+     * Make the space bigger without touching existing allocations.
+     *
+     * @param size new size. Must not be smaller than the current size
+     */
+    void grow(unsigned int size);
+
+    /**
+     * Allocate a range.
+     *
+     * The first free range large enough is used.
+     *
+     * @param count length of the range
+     * @return start of the range or -1 if there is no room
+     */
+    int allocate(unsigned int count);
+
+    /**
+     * Release a previously allocated range.
+     *
+     * @param first start of the range
+     * @param count length of the range
+     */
+    void release(unsigned int first, unsigned int count);
+
+    /**
+     * Get the total size of the space.
+     *
+     * @return size
+     */
+    unsigned int size() const { return m_size; }
+
+    /**
+     * Get the end of the allocated part of the space.
+     *
+     * Everything from here to the end of the space is free.
+     *
+     * @return one past the last allocated element or 0 if nothing is allocated
+     */
+    unsigned int top() const;
+
+private:
+    // Free ranges: start -> length
+    std::map<unsigned int, unsigned int> m_free;
+    unsigned int m_size;
+};
+
+#endif
+
@@ -15,13 +15,36 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <algorithm>
+#include <exception>
+
 #include "threadpool.h"
 
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #ifndef NDEBUG
 #include <iostream>
 #endif
 
 static ThreadPool *SINGLETON;
+static ThreadPool *BACKGROUND;
+
+namespace {
+    // Nice value of background worker threads
+    const int BACKGROUND_NICE = 10;
+
+    void lowerPriority()
+    {
+#ifdef __linux__
+        // On Linux, the nice value is per thread
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), BACKGROUND_NICE);
+#endif
+    }
+}
 
 void ThreadPool::initSingleton(int threads)
 {
@@ -39,23 +62,84 @@ void ThreadPool::initSingleton(int threads)
     std::cerr << "Starting thread pool singleton with " << t << " threads." << std::endl;
 #endif
     SINGLETON = new ThreadPool(t);
+    BACKGROUND = new ThreadPool(1, true);
 }
 
 TaskFuture ThreadPool::run(TaskFunction &&fn)
 {
-    assert(SINGLETON != nullptr);
+    if(SINGLETON == nullptr) {
+        Task task(std::move(fn));
+        TaskFuture future = task.get_future();
+        task();
+        return future;
+    }
     return SINGLETON->enqueue(std::move(fn));
 }
 
+TaskFuture ThreadPool::runBackground(TaskFunction &&fn)
+{
+    if(BACKGROUND == nullptr) {
+        Task task(std::move(fn));
+        TaskFuture future = task.get_future();
+        task();
+        return future;
+    }
+    return BACKGROUND->enqueue(std::move(fn));
+}
+
+void ThreadPool::parallelFor(unsigned int begin, unsigned int end, unsigned int chunk, const RangeFunction &fn)
+{
+    assert(chunk > 0);
+    if(begin >= end)
+        return;
+
+    if(SINGLETON == nullptr || end - begin <= chunk) {
+        for(unsigned int b=begin;b<end;b+=std::min(chunk, end-b))
+            fn(b, b + std::min(chunk, end-b));
+        return;
+    }
+
+    std::vector<TaskFuture> futures;
+    futures.reserve((end - begin) / chunk);
+    for(unsigned int b=begin+chunk;b<end;b+=chunk) {
+        const unsigned int e = b + std::min(chunk, end-b);
+        futures.push_back(SINGLETON->enqueue([&fn, b, e]() -> boost::any {
+            fn(b, e);
+            return boost::any();
+        }));
+    }
+
+    // The tasks refer to fn, so they must all finish before returning,
+    // even if the first chunk fails.
+    std::exception_ptr error;
+    try {
+        fn(begin, begin + chunk);
+    } catch(...) {
+        error = std::current_exception();
+    }
+
+    for(TaskFuture &f : futures)
+        f.wait();
+
+    if(error)
+        std::rethrow_exception(error);
+
+    for(TaskFuture &f : futures)
+        f.get();
+}
+
 void ThreadPool::shutdownSingleton()
 {
     delete SINGLETON;
     SINGLETON = 0;
+    delete BACKGROUND;
+    BACKGROUND = 0;
 }
 
-ThreadPool::ThreadPool(int threads)
+ThreadPool::ThreadPool(int threads, bool background)
 {
     m_runflag = true;
+    m_background = background;
     for(int i=0;i<threads;++i)
         m_threads.add_thread(new boost::thread(&ThreadPool::workerFunc, this));
 }
@@ -77,6 +161,9 @@ TaskFuture ThreadPool::enqueue(TaskFunction &&fn)
 
 void ThreadPool::workerFunc()
 {
+    if(m_background)
+        lowerPriority();
+
     while(m_runflag) {
         Task t;
 
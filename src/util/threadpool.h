@@ -25,6 +25,7 @@
 typedef std::function<boost::any()> TaskFunction;
 typedef boost::packaged_task<boost::any> Task;
 typedef boost::unique_future<boost::any> TaskFuture;
+typedef std::function<void(unsigned int, unsigned int)> RangeFunction;
 
 /**
  * A thread pool.
@@ -39,8 +40,9 @@ class ThreadPool {
          * Construct a new thread pool with the given number of threads.
          *
          * \param threads number of threads. Must be greater than zero.
+         * \param background run the threads at a lower OS priority (where supported)
          */
-        ThreadPool(int threads);
+        ThreadPool(int threads, bool background=false);
 
         /**
          * Destruct the pool and stop all threads.
@@ -61,6 +63,9 @@ class ThreadPool {
          * Initialize the singleton pool.
          * The pool will contain at least two threads, or more
          * if more processors are available.
+         *
+         * A separate background worker thread is started as well
+         * (see runBackground().)
 		 *
 		 * @param threads number of threads. If zero or below, the number is determined automatically.
          */
@@ -69,10 +74,45 @@ class ThreadPool {
         /**
          * Enqueue a task to be executed on the Singleton pool.
          *
-         * initSingleton() must have been called before.
+         * If the singleton has not been initialized, the task is
+         * executed immediately in the calling thread.
          */
         static TaskFuture run(TaskFunction &&fn);
 
+        /**
+         * Enqueue a low priority task on the background worker.
+         *
+         * Background tasks run one at a time on a thread of their own
+         * with a lowered OS priority, so long running jobs never delay
+         * the tasks of run() and parallelFor().
+         *
+         * If the singleton has not been initialized, the task is
+         * executed immediately in the calling thread.
+         */
+        static TaskFuture runBackground(TaskFunction &&fn);
+
+        /**
+         * Process a range of indices in parallel on the singleton pool.
+         *
+         * The range is split into chunks of the given size (the last one may
+         * be shorter.) The split does not depend on the number of threads,
+         * so as long as the chunks are independent of each other, the
+         * results are the same as when processing the range serially.
+         *
+         * The calling thread processes the first chunk itself and then waits
+         * for the rest to finish. If the singleton has not been initialized,
+         * all chunks are processed in the calling thread.
+         *
+         * This must not be called from inside a pool task.
+         *
+         * \param begin first index
+         * \param end last index + 1
+         * \param chunk chunk size. Must be greater than zero.
+         * \param fn the function to call for each chunk: fn(begin, end)
+         * \throw rethrows the first exception thrown by fn
+         */
+        static void parallelFor(unsigned int begin, unsigned int end, unsigned int chunk, const RangeFunction &fn);
+
         /**
          * Shut down the singleton thread pool.
          */
@@ -85,6 +125,7 @@ class ThreadPool {
         boost::condition_variable m_taskcond;
 
         bool m_runflag;
+        bool m_background;
 
         void workerFunc();
 };
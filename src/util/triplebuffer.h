@@ -0,0 +1,105 @@
+//
+// This file is part of Luola2.
+// Copyright (C) 2012 Calle Laakkonen
+//
+// Luola2 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Luola2 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef LUOLA_UTIL_TRIPLEBUFFER_H
+#define LUOLA_UTIL_TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * A lock-free triple buffer for passing state from one producer
+ * thread to one consumer thread.
+ *
+ * The producer fills in the write buffer and publishes it. The consumer
+ * picks up the most recently published buffer whenever it is ready.
+ * Neither side ever waits for the other: if the producer is faster,
+ * intermediate buffers are simply skipped.
+ *
+ * Buffers are recycled, so the producer must overwrite the whole
+ * contents of the write buffer before publishing.
+ */
+template<typename Type>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : m_write(0), m_middle(1), m_read(2)
+    {
+    }
+
+    /**
+     * Get the buffer the producer is filling in.
+     *
+     * @return write buffer
+     */
+    Type &writeBuffer() { return m_buffers[m_write]; }
+
+    /**
+     * Publish the write buffer.
+     *
+     * The write buffer is swapped with the middle buffer, which becomes
+     * available to the consumer.
+     */
+    void publish()
+    {
+        m_write = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    /**
+     * Pick up the latest published buffer.
+     *
+     * If nothing new has been published since the last call,
+     * the read buffer is left as it was.
+     *
+     * @return true if the read buffer changed
+     */
+    bool update()
+    {
+        if(!(m_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    /**
+     * Get the buffer the consumer is reading.
+     *
+     * The consumer may modify the buffer, since the producer
+     * overwrites it anyway.
+     *
+     * @return read buffer
+     */
+    Type &readBuffer() { return m_buffers[m_read]; }
+    const Type &readBuffer() const { return m_buffers[m_read]; }
+
+private:
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer &operator=(const TripleBuffer&) = delete;
+
+    // The middle index is tagged with a flag telling whether
+    // it holds a buffer the consumer has not seen yet
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    Type m_buffers[3];
+    unsigned int m_write;
+    std::atomic<unsigned int> m_middle;
+    unsigned int m_read;
+};
+
+#endif
+
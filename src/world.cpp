@@ -15,38 +15,184 @@
 // You should have received a copy of the GNU General Public License
 // along with Luola2.  If not, see <http://www.gnu.org/licenses/>.
 //
-#include <iostream>
+#include <algorithm>
+
+#include <glm/gtx/norm.hpp>
 
 #include "world.h"
 #include "ship/ship.h"
+#include "projectile/projectiledef.h"
+#include "util/threadpool.h"
+
+namespace {
+    // Parallel work split granularity
+    const unsigned int SHIP_CHUNK = 16;
+    const unsigned int PAIR_CHUNK = 256;
+
+    // Objects this close to a new hole are woken up
+    const float WAKE_MARGIN = 0.1f;
+
+    // Default number of ticks between starting a terrain cut and
+    // applying it. Like compaction below, the cut is applied at a fixed
+    // tick so the result does not depend on thread timing. Cutting a
+    // tile takes well under a millisecond, so four ticks leaves plenty
+    // of slack for the background worker even when a compaction job
+    // is queued ahead of the cut.
+    const unsigned int CUT_DELAY = 4;
+
+    // Terrain compaction is swapped in this many ticks after it was
+    // started. A fixed delay keeps the simulation deterministic no
+    // matter how long the background task actually takes. The swap
+    // cannot be postponed based on whether the job is done, since that
+    // would depend on timing. Instead, the delay is long enough that
+    // waiting should never happen: compacting a badly fragmented
+    // 16x16 tile takes about 1 ms and a 40x40 block about 10 ms
+    // (see the "compaction" benchmark), while 30 ticks is 500 ms.
+    const uint64_t COMPACTION_DELAY = 30;
+
+    // Terrain fragments smaller than this are removed in compaction
+    const float COMPACTION_MIN_AREA = 0.01f;
+}
+
+World::World(unsigned int maxprojectiles)
+    : m_projectiles(maxprojectiles), m_snapshotsenabled(false), m_tick(0),
+      m_zonebuffer(GL_STATIC_DRAW), m_staticbuffer(GL_STATIC_DRAW), m_dynbuffer(GL_DYNAMIC_DRAW),
+      m_cutdelay(CUT_DELAY)
+{
+}
 
 void World::step()
 {
-    // Ships
+    m_collisions.clear();
+
+    // Ship state at the start of the step
+    if(m_snapshotsenabled) {
+        std::vector<RenderSnapshot::Ship> &ships = m_snapshots.writeBuffer().ships;
+        ships.resize(m_ships.size());
+        for(unsigned int i=0;i<m_ships.size();++i) {
+            ships[i].prevpos = m_ships[i].physics().position();
+            ships[i].prevangle = m_ships[i].angle();
+        }
+    }
+
+    // Ship logic. This can launch projectiles, so it is done serially
+    for(Ship &ship : m_ships)
+        ship.shipStep(*this);
+
+    // Ship movement and terrain collisions. Each ship only changes
+    // its own state here, so they can be processed in parallel.
+    m_shipsteps.resize(m_ships.size());
+    ThreadPool::parallelFor(0, m_ships.size(), SHIP_CHUNK, [this](unsigned int begin, unsigned int end) {
+        for(unsigned int i=begin;i<end;++i)
+            m_shipsteps[i].result = m_ships[i].physics().step(*this, &m_shipsteps[i].contact);
+    });
+
     for(unsigned int i=0;i<m_ships.size();++i) {
-        Physical &obj = m_ships[i].physics();
+        if(m_shipsteps[i].result == Physical::HIT_TERRAIN) {
+            const Physical::Contact &c = m_shipsteps[i].contact;
+            CollisionEvent e;
+            e.type = CollisionEvent::SHIP_TERRAIN;
+            e.ship = i;
+            e.other = 0;
+            e.point = c.point - c.normal * m_ships[i].physics().radius();
+            e.normal = c.normal;
+            m_collisions.push_back(e);
+        }
+    }
 
-        m_ships[i].shipStep(*this);
-        obj.step(*this);
+    // Object-object collisions.
+    // These are checked only after all the ships have moved, so every
+    // pair is tested against the positions at the end of this tick.
+    m_broadphase.clear();
+    for(const Ship &ship : m_ships)
+        m_broadphase.add(ship.physics().position(), ship.physics().radius());
 
-        // Object-object collisions
-        for(unsigned int j=i+1;j<m_ships.size();++j) {
-            if(obj.checkCollision(m_ships[j].physics())) {
-                std::cout << "collision " << i << "--" << j << std::endl;
-            }
+    m_broadphase.findPairs(m_pairs);
+
+    // Collision responses are calculated in parallel, but applied
+    // in pair order so the result does not depend on thread timing.
+    m_contacts.resize(m_pairs.size());
+    ThreadPool::parallelFor(0, m_pairs.size(), PAIR_CHUNK, [this](unsigned int begin, unsigned int end) {
+        for(unsigned int i=begin;i<end;++i) {
+            const Broadphase::Pair &pair = m_pairs[i];
+            const Physical &first = m_ships[pair.first].physics();
+            const Physical &second = m_ships[pair.second].physics();
+            Contact &c = m_contacts[i];
+
+            // Two sleeping objects resting against each other stay put
+            if(first.isAsleep() && second.isAsleep())
+                c.hit = false;
+            else
+                c.hit = first.collisionImpulse(second, c.impulse);
+        }
+    });
+
+    for(unsigned int i=0;i<m_pairs.size();++i) {
+        if(m_contacts[i].hit) {
+            const Broadphase::Pair &pair = m_pairs[i];
+            Physical &first = m_ships[pair.first].physics();
+            Physical &second = m_ships[pair.second].physics();
+
+            CollisionEvent e;
+            e.type = CollisionEvent::SHIP_SHIP;
+            e.ship = pair.first;
+            e.other = pair.second;
+            e.normal = glm::normalize(first.position() - second.position());
+            e.point = second.position() + e.normal * second.radius();
+            m_collisions.push_back(e);
+
+            first.addImpulse(m_contacts[i].impulse);
+            second.addImpulse(-m_contacts[i].impulse);
         }
     }
 
     // Projectiles
-    for(unsigned int i=0;i<m_projectiles.size();++i) {
-        Physical &obj = m_projectiles[i].physics();
+    m_projectiles.step(*this, m_collisions);
+
+    // Terrain damage. Holes are cut in the background and the
+    // result is swapped in at the end of a later step.
+    finishHoles();
+    compactTerrain();
+    startHoles();
 
-        obj.step(*this);
+    ++m_tick;
+    if(m_snapshotsenabled)
+        publishSnapshot();
+}
+
+void World::publishSnapshot()
+{
+    RenderSnapshot &snapshot = m_snapshots.writeBuffer();
+    snapshot.tick = m_tick;
+
+    // The start of step state was recorded at the beginning of the step
+    for(unsigned int i=0;i<m_ships.size();++i) {
+        RenderSnapshot::Ship &s = snapshot.ships[i];
+        s.player = m_ships[i].player();
+        s.pos = m_ships[i].physics().position();
+        s.angle = m_ships[i].angle();
+        s.radius = m_ships[i].physics().radius();
+        s.model = m_ships[i].model();
     }
+
+    // Every projectile left in play was moved during this step
+    snapshot.projectiles.resize(m_projectiles.size());
+    for(unsigned int i=0;i<m_projectiles.size();++i) {
+        RenderSnapshot::Projectile &p = snapshot.projectiles[i];
+        p.pos = m_projectiles.position(i);
+        p.prevpos = p.pos - m_projectiles.displacement(i);
+        p.radius = m_projectiles.radius(i);
+        p.mesh = m_projectiles.def(i)->mesh();
+    }
+
+    m_snapshots.publish();
 }
 
 terrain::ZoneProps World::zoneAt(const terrain::Point &p) const
 {
+    if(m_zoneindex.isBuilt())
+        return m_zoneindex.zoneAt(p, m_rootzone);
+
     terrain::ZoneProps zp = m_rootzone;
 
     // A point can be part of multiple zones
@@ -60,17 +206,26 @@ terrain::ZoneProps World::zoneAt(const terrain::Point &p) const
 
 bool World::checkTerrainCollision(const terrain::Point &p, float r, const glm::vec2 &v, terrain::Point &cp, glm::vec2 &normal) const
 {
-    for(const terrain::Solid *s : m_dyn_terrain) {
-        if(s->circleCollision(p, r, v, cp, normal))
-            return true;
-    }
+    // Find the nearest collision point among the terrain blocks
+    // whose bounds the circle passes through.
+    float nearest = -1;
+    unsigned int nearestsolid = 0;
 
-    for(const terrain::Solid *s : m_static_terrain) {
-        if(s->circleCollision(p, r, v, cp, normal))
-            return true;
-    }
+    terrain::Point colp;
+    glm::vec2 colnormal;
+    m_solidtree.query(terrain::sweptCircleBounds(p, r, v), [&](unsigned int i) {
+        if(m_solids[i]->circleCollision(p, r, v, colp, colnormal)) {
+            const float dist = glm::distance2(colp, p);
+            if(nearest < 0 || dist < nearest || (dist == nearest && i < nearestsolid)) {
+                nearest = dist;
+                nearestsolid = i;
+                cp = colp;
+                normal = colnormal;
+            }
+        }
+    });
 
-    return false;
+    return nearest >= 0;
 }
 
 void World::addShip(const Ship &ship)
@@ -78,9 +233,9 @@ void World::addShip(const Ship &ship)
     m_ships.push_back(ship);
 }
 
-void World::addProjectile(const Projectile &projectile)
+PoolHandle World::addProjectile(const Projectile &projectile)
 {
-    m_projectiles.push_back(projectile);
+    return m_projectiles.add(projectile);
 }
 
 Ship *World::getPlayerShip(int player)
@@ -98,13 +253,26 @@ void World::addZone(terrain::Zone *zone)
 {
     assert(zone);
     m_zones.push_back(zone);
+    m_zoneindex.clear();
+    zone->setBuffer(&m_zonebuffer);
     zone->updateGl();
 }
 
+void World::indexZones()
+{
+    m_zoneindex.build(m_zones, m_bounds);
+}
+
 void World::addSolid(terrain::Solid *solid)
 {
     assert(solid);
     m_dyn_terrain.push_back(solid);
+    m_dyn_proxies.push_back(insertSolid(solid, m_dyn_terrain.size() - 1));
+    m_compactiondue.push_back(0);
+    m_cutdue.push_back(0);
+    m_cutholes.push_back(std::vector<terrain::ConvexPolygon>());
+    m_pendingholes.push_back(std::vector<terrain::ConvexPolygon>());
+    solid->setBuffer(&m_dynbuffer);
     solid->updateGl();
 }
 
@@ -112,14 +280,134 @@ void World::addStaticSolid(terrain::Solid *solid)
 {
     assert(solid);
     m_static_terrain.push_back(solid);
+    insertSolid(solid, -1);
+    solid->setBuffer(&m_staticbuffer);
     solid->updateGl();
 }
 
+int World::insertSolid(const terrain::Solid *solid, int dynindex)
+{
+    m_solids.push_back(solid);
+    m_solid_dynindex.push_back(dynindex);
+    if(solid->isEmpty())
+        return terrain::AABBTree::NULL_NODE;
+    return m_solidtree.insert(solid->bounds(), m_solids.size() - 1);
+}
+
 void World::makeHole(const terrain::ConvexPolygon &hole)
 {
-    for(terrain::Solid *s : m_dyn_terrain) {
-        // TODO update GL only just before we need to render
-        if(s->nibble(hole))
-            s->updateGl();
+    m_holes.push_back(hole);
+}
+
+void World::finishHoles()
+{
+    for(unsigned int i=0;i<m_dyn_terrain.size();++i) {
+        if(m_dyn_terrain[i]->isCutting() && m_tick >= m_cutdue[i]) {
+            m_dyn_terrain[i]->finishNibble();
+            updateSolidProxy(i);
+            wakeShips(m_cutholes[i]);
+            m_cutholes[i].clear();
+        }
+    }
+}
+
+void World::startHoles()
+{
+    // Sort the holes by the destructible solids they may touch.
+    // Holes that hit a solid still being cut wait for the next cut.
+    if(!m_holes.empty()) {
+        m_holehits.clear();
+        for(unsigned int h=0;h<m_holes.size();++h) {
+            m_solidtree.query(m_holes[h].bounds(), [this, h](unsigned int i) {
+                if(m_solid_dynindex[i] >= 0)
+                    m_holehits.push_back(std::make_pair(m_solid_dynindex[i], h));
+            });
+        }
+
+        std::sort(m_holehits.begin(), m_holehits.end());
+        for(const std::pair<int, unsigned int> &hit : m_holehits)
+            m_pendingholes[hit.first].push_back(m_holes[hit.second]);
+
+        m_holes.clear();
+    }
+
+    // Each solid is cut only once, with all its holes
+    for(unsigned int i=0;i<m_dyn_terrain.size();++i) {
+        std::vector<terrain::ConvexPolygon> &holes = m_pendingholes[i];
+        terrain::Solid *s = m_dyn_terrain[i];
+        if(holes.empty() || s->isCutting())
+            continue;
+
+        if(m_cutdelay == 0) {
+            if(s->nibble(holes)) {
+                updateSolidProxy(i);
+                wakeShips(holes);
+            }
+        } else if(s->startNibble(holes)) {
+            m_cutdue[i] = m_tick + m_cutdelay;
+            m_cutholes[i].swap(holes);
+        }
+        holes.clear();
+    }
+}
+
+void World::wakeShips(const std::vector<terrain::ConvexPolygon> &holes)
+{
+    // Objects resting on the destroyed terrain must fall
+    for(Ship &ship : m_ships) {
+        Physical &p = ship.physics();
+        if(!p.isAsleep())
+            continue;
+
+        const terrain::BRect bounds = terrain::sweptCircleBounds(p.position(), p.radius() + WAKE_MARGIN, glm::vec2());
+        for(const terrain::ConvexPolygon &hole : holes) {
+            if(bounds.overlaps(hole.bounds())) {
+                p.wake();
+                break;
+            }
+        }
     }
 }
+
+void World::compactTerrain()
+{
+    for(unsigned int i=0;i<m_dyn_terrain.size();++i) {
+        terrain::Solid *s = m_dyn_terrain[i];
+        if(s->isCompacting()) {
+            // The compacted polygons cannot be swapped in under a
+            // running cut without waiting for it, so the swap is put off
+            // until the cut has been applied. Whether a cut is running
+            // depends only on the tick, so this is still deterministic.
+            if(m_tick >= m_compactiondue[i] && !s->isCutting()) {
+                s->finishCompaction();
+                updateSolidProxy(i);
+            }
+        } else if(s->isFragmented()) {
+            s->startCompaction(COMPACTION_MIN_AREA);
+            m_compactiondue[i] = m_tick + COMPACTION_DELAY;
+        }
+    }
+}
+
+void World::updateSolidProxy(unsigned int i)
+{
+    // Solids only ever shrink, but the tree must still be
+    // updated to keep queries tight.
+    const int proxy = m_dyn_proxies[i];
+    if(proxy == terrain::AABBTree::NULL_NODE)
+        return;
+
+    if(m_dyn_terrain[i]->isEmpty()) {
+        m_solidtree.remove(proxy);
+        m_dyn_proxies[i] = terrain::AABBTree::NULL_NODE;
+    } else {
+        m_solidtree.update(proxy, m_dyn_terrain[i]->bounds());
+    }
+}
+
+void World::updateGl()
+{
+    // Nothing is uploaded unless the terrain has changed
+    for(terrain::Solid *s : m_dyn_terrain)
+        s->updateGl();
+}
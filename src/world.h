@@ -19,10 +19,18 @@
 #define LUOLA_WORLD_H
 
 #include <vector>
+#include <utility>
 
 #include "terrain/terrains.h"
+#include "terrain/zoneindex.h"
+#include "terrain/terrainbuffer.h"
 #include "ship/ship.h"
 #include "projectile/projectile.h"
+#include "projectile/projectilestore.h"
+#include "broadphase.h"
+#include "collisionevent.h"
+#include "rendersnapshot.h"
+#include "util/triplebuffer.h"
 
 /**
  * Game world state
@@ -30,10 +38,58 @@
 class World {
     friend class Renderer;
 public:
+    /**
+     * Default maximum number of projectiles in play at the same time.
+     *
+     * New projectiles are not launched while the pool is full.
+     */
+    static const unsigned int MAX_PROJECTILES = 8192;
+
+    /**
+     * Construct an empty world.
+     *
+     * @param maxprojectiles projectile pool size
+     */
+    explicit World(unsigned int maxprojectiles=MAX_PROJECTILES);
 
-    // Simulate one timestep
+    /**
+     * Simulate one timestep.
+     *
+     * Per-object work is split across the thread pool (if initialized.)
+     * The result is the same regardless of the number of threads.
+     */
     void step();
 
+    /**
+     * Get the collisions that happened during the last step.
+     *
+     * The events are ordered the same way regardless of the
+     * number of threads. The list is cleared at the start of each step.
+     *
+     * @return collision events
+     */
+    const std::vector<CollisionEvent> &collisions() const { return m_collisions; }
+
+    /**
+     * Enable or disable render snapshots.
+     *
+     * When enabled, a snapshot of the game objects is published
+     * at the end of each step. Disabled by default.
+     *
+     * @param enable enable snapshots
+     */
+    void setSnapshotsEnabled(bool enable) { m_snapshotsenabled = enable; }
+
+    /**
+     * Get the render snapshot buffer.
+     *
+     * The world is the producer of the buffer. The renderer (possibly
+     * running in another thread) is the consumer.
+     *
+     * @return snapshot triple buffer
+     */
+    TripleBuffer<RenderSnapshot> &snapshots() { return m_snapshots; }
+
     //// Querying
 
     /**
@@ -79,9 +135,21 @@ public:
     /**
      * Add a new projectile to the world.
      *
+     * The projectile is removed automatically when it expires or
+     * hits something.
+     *
      * @param projectile the projectile
+     * @return handle to the projectile or a null handle if there is no room
+     */
+    PoolHandle addProjectile(const Projectile &projectile);
+
+    /**
+     * Get the projectiles in play.
+     *
+     * @return projectile store
      */
-    void addProjectile(const Projectile &projectile);
+    ProjectileStore &projectiles() { return m_projectiles; }
+    const ProjectileStore &projectiles() const { return m_projectiles; }
 
     /**
      * Set root zone properties
@@ -113,6 +181,15 @@ public:
      */ 
     void addZone(terrain::Zone *zone);
 
+    /**
+     * Build the zone lookup index.
+     *
+     * This should be called after the level has been loaded. Adding
+     * a new zone invalidates the index. Without an index, zone lookups
+     * still work, but are slower.
+     */
+    void indexZones();
+
     /**
      * Add destructible terrain to the world.
      *
@@ -134,14 +211,94 @@ public:
     /**
      * Make a hole in destructible terrain
      *
+     * Holes are queued and cut together in the background at the end
+     * of the step, so each terrain block is cut only once per tick.
+     * The terrain changes at the end of the step cutDelay() ticks later.
+     * Until then, the terrain collides as it was before the hole.
+     * Holes that hit a terrain block that is still being cut are
+     * cut after the earlier cut has been applied.
+     *
      * @param hole hole shape
      */
     void makeHole(const terrain::ConvexPolygon &hole);
 
+    /**
+     * Set the number of ticks between starting a terrain cut and applying it.
+     *
+     * The cut is applied at exactly this tick, waiting for the background
+     * worker if it has not finished yet, so the simulation stays
+     * deterministic. A longer delay makes waiting less likely, but the
+     * terrain lags further behind the explosions.
+     * Zero means the holes are cut synchronously at the end of the
+     * step they were made in. The default is 4 ticks.
+     *
+     * @param ticks delay in ticks
+     */
+    void setCutDelay(unsigned int ticks) { m_cutdelay = ticks; }
+
+    /**
+     * Get the number of ticks between starting a terrain cut and applying it.
+     *
+     * @return delay in ticks
+     */
+    unsigned int cutDelay() const { return m_cutdelay; }
+
+    /**
+     * Update the OpenGL buffers of terrain that has changed.
+     *
+     * This should be called just before rendering.
+     */
+    void updateGl();
+
 private:
+    // Apply the terrain cuts that are due on this step
+    void finishHoles();
+
+    // Start cutting the queued holes out of the terrain
+    void startHoles();
+
+    // Wake up sleeping objects near the holes
+    void wakeShips(const std::vector<terrain::ConvexPolygon> &holes);
+
+    // Start and finish background compaction of fragmented terrain
+    void compactTerrain();
+
+    // Update the tree leaf of a destructible solid after it has changed
+    void updateSolidProxy(unsigned int i);
+
+    // Add a solid to the terrain tree. Returns the tree proxy
+    int insertSolid(const terrain::Solid *solid, int dynindex);
+
+    // Fill in the end of step state and publish the snapshot
+    void publishSnapshot();
+
     // Game objects
     std::vector<Ship> m_ships;
-    std::vector<Projectile> m_projectiles;
+    ProjectileStore m_projectiles;
+
+    // Collisions of the current step
+    std::vector<CollisionEvent> m_collisions;
+
+    // Render snapshots
+    TripleBuffer<RenderSnapshot> m_snapshots;
+    bool m_snapshotsenabled;
+    uint64_t m_tick;
+
+    // Ship terrain collisions
+    struct ShipStep {
+        Physical::StepResult result;
+        Physical::Contact contact;
+    };
+    std::vector<ShipStep> m_shipsteps;
+
+    // Ship-ship collision detection
+    struct Contact {
+        bool hit;
+        glm::vec2 impulse;
+    };
+    Broadphase m_broadphase;
+    std::vector<Broadphase::Pair> m_pairs;
+    std::vector<Contact> m_contacts;
 
     // Root zone properties
     terrain::ZoneProps m_rootzone;
@@ -149,12 +306,40 @@ private:
 
     // Flythrough zones
     std::vector<terrain::Zone*> m_zones;
+    terrain::ZoneIndex m_zoneindex;
+    terrain::TerrainBuffer m_zonebuffer;
 
     // Indestructible terrain
     std::vector<terrain::Solid*> m_static_terrain;
+    terrain::TerrainBuffer m_staticbuffer;
 
     // Destructible terrain
     std::vector<terrain::Solid*> m_dyn_terrain;
+    std::vector<int> m_dyn_proxies;
+    terrain::TerrainBuffer m_dynbuffer;
+
+    // Holes to be made at the end of the step
+    std::vector<terrain::ConvexPolygon> m_holes;
+    std::vector<std::pair<int, unsigned int>> m_holehits;
+    unsigned int m_cutdelay;
+
+    // For each destructible solid, the tick at which the running
+    // cut is applied, the holes being cut and the holes waiting
+    // for the next cut.
+    std::vector<uint64_t> m_cutdue;
+    std::vector<std::vector<terrain::ConvexPolygon>> m_cutholes;
+    std::vector<std::vector<terrain::ConvexPolygon>> m_pendingholes;
+
+    // For each destructible solid, the tick at which its
+    // background compaction is swapped in
+    std::vector<uint64_t> m_compactiondue;
+
+    // Bounding volume hierarchy over all solid terrain.
+    // The leaf data is an index to m_solids. For each solid,
+    // m_solid_dynindex has its index in m_dyn_terrain (or -1 if static.)
+    std::vector<const terrain::Solid*> m_solids;
+    std::vector<int> m_solid_dynindex;
+    terrain::AABBTree m_solidtree;
 };
 
 #endif